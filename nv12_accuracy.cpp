@@ -0,0 +1,569 @@
+// nv12_accuracy.cpp
+// NV12 -> RGB 各后端的正确性和精度检查
+//
+// Build:
+// g++ -O2 -std=c++17 -pthread nv12_accuracy.cpp -o nv12_accuracy
+//
+// Run:
+// ./nv12_accuracy                       CPU后端 (所有内核、输出格式、颜色空间、多线程版本) 与参考实现逐字节比较，
+//                                       有任何不一致时返回非0
+// ./nv12_accuracy --write=DIR           把测试图样写成 DIR/<图样>.nv12 (640x480)，给GPU后端当输入
+// ./nv12_accuracy --compare=out.rgb [--format=...] [--stride=N] [--flip] [--matrix=...] [--range=...] input.nv12 width height
+//                                       报告其他后端输出的RGB与参考实现的最大、平均绝对误差和PSNR
+//                                       --format: rgb24 (默认)、rgba、bgra (每像素4字节，忽略A) 或
+//                                       rgbf32 (R、G、B三个float平面，0~1); --stride: 每行字节数，默认紧凑排列
+//
+// GLES (llvmpipe) 例:
+//   mkdir -p patterns && ./nv12_accuracy --write=patterns
+//   for p in gradient noise saturated edges; do
+//     cp patterns/$p.nv12 frame_nv12.raw && LIBGL_ALWAYS_SOFTWARE=1 ./nv12_gbm_egl bt601 limited &&
+//     ./nv12_accuracy --compare=output.rgb --flip frame_nv12.raw 640 480
+//   done
+// (glReadPixels 从最下面一行开始读，所以GL的输出要加 --flip)
+//
+// Vulkan (vulkanDemo，lavapipe 或其他驱动) 例: 输出尺寸等于输入、nearest 时只做转换，
+// 输出为从上到下的紧凑RGBA8，不用 --flip:
+//   for p in gradient noise saturated edges; do
+//     vulkanDemo/nv12_scaler patterns/$p.nv12 640 480 640 480 vulkanDemo/compute_nv12.spv out.rgba 1 nearest rgba bt709 full &&
+//     ./nv12_accuracy --compare=out.rgba --format=rgba --matrix=bt709 --range=full patterns/$p.nv12 640 480
+//   done
+// (rgbf32 输出同样可以比较: ... rgbf32 ... 和 --format=rgbf32)
+//
+// 参考实现: 逐像素的定点公式 (nv12_color.h 的 NV12FixedColorCoefficients)，与内核代码无关。
+// 定点系数本身和 nv12_color.h 共用，所以另外做两项独立检查，不一致时同样算失败:
+//   - 每个颜色空间的定点系数与下面按标准手算的 kGoldenCoefficients 一致
+//   - 定点参考与按标准的 Kr/Kb 独立推导的浮点公式相差不超过 kFloatTolerance
+// 浮点公式的误差同时也是GPU后端误差的下限参考。
+
+#define NV12_TO_RGB_NO_MAIN
+#include "nv12_to_rgb.cpp"
+
+#include <cmath>
+#include <string>
+
+// 测试用的NV12帧，宽高可以是奇数: UV平面每行 (width+1)/2 对，共 (height+1)/2 行
+struct NV12TestFrame {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> uv;
+
+    NV12TestFrame(int w, int h) : width(w), height(h), y(static_cast<size_t>(w) * h), uv(uv_pitch() * ((h + 1) / 2)) {}
+
+    int uv_pitch() const { return (width + 1) & ~1; }
+};
+
+// ---- 测试图样 ----
+
+// 水平亮度渐变，U 沿垂直方向、V 沿对角方向渐变，覆盖每个输入值
+static void FillGradient(NV12TestFrame& f) {
+    for (int j = 0; j < f.height; j++) {
+        for (int i = 0; i < f.width; i++) f.y[j * f.width + i] = static_cast<uint8_t>(i * 255 / std::max(f.width - 1, 1));
+    }
+    int uv_rows = (f.height + 1) / 2;
+    for (int j = 0; j < uv_rows; j++) {
+        for (int i = 0; i < f.uv_pitch() / 2; i++) {
+            f.uv[j * f.uv_pitch() + 2 * i] = static_cast<uint8_t>(j * 255 / std::max(uv_rows - 1, 1));
+            f.uv[j * f.uv_pitch() + 2 * i + 1] = static_cast<uint8_t>((i + j) & 255);
+        }
+    }
+}
+
+// 固定种子的随机噪声
+static void FillNoise(NV12TestFrame& f) {
+    uint32_t state = 2463534242u;
+    auto next = [&state] {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<uint8_t>(state);
+    };
+    for (uint8_t& v : f.y) v = next();
+    for (uint8_t& v : f.uv) v = next();
+}
+
+// 8种饱和色 (RGB各分量为0或255) 的竖条，按 BT.601 limited 正向转换成YUV
+static void FillSaturated(NV12TestFrame& f) {
+    const double kr = 0.299, kb = 0.114, kg = 1.0 - kr - kb;
+    uint8_t yuv[8][3];
+    for (int c = 0; c < 8; c++) {
+        double r = (c >> 2) & 1, g = (c >> 1) & 1, b = c & 1;
+        double luma = kr * r + kg * g + kb * b;
+        yuv[c][0] = static_cast<uint8_t>(std::lround(16 + 219 * luma));
+        yuv[c][1] = static_cast<uint8_t>(std::lround(128 + 224 * (b - luma) / (2 * (1 - kb))));
+        yuv[c][2] = static_cast<uint8_t>(std::lround(128 + 224 * (r - luma) / (2 * (1 - kr))));
+    }
+    auto bar = [&f](int x) { return std::min(x * 8 / std::max(f.width, 1), 7); };
+    for (int j = 0; j < f.height; j++) {
+        for (int i = 0; i < f.width; i++) f.y[j * f.width + i] = yuv[bar(i)][0];
+    }
+    for (int j = 0; j < (f.height + 1) / 2; j++) {
+        for (int i = 0; i < f.uv_pitch() / 2; i++) {
+            f.uv[j * f.uv_pitch() + 2 * i] = yuv[bar(2 * i)][1];
+            f.uv[j * f.uv_pitch() + 2 * i + 1] = yuv[bar(2 * i)][2];
+        }
+    }
+}
+
+// 边界值: Y 和 UV 轮流取 0/16/128/235/240/255 的所有组合，检查截断和溢出
+static void FillEdges(NV12TestFrame& f) {
+    static const uint8_t kValues[] = { 0, 16, 128, 235, 240, 255 };
+    const int n = sizeof(kValues);
+    for (int j = 0; j < f.height; j++) {
+        for (int i = 0; i < f.width; i++) f.y[j * f.width + i] = kValues[(i + j) % n];
+    }
+    for (int j = 0; j < (f.height + 1) / 2; j++) {
+        for (int i = 0; i < f.uv_pitch() / 2; i++) {
+            int combo = (i + j * 7) % (n * n);
+            f.uv[j * f.uv_pitch() + 2 * i] = kValues[combo / n];
+            f.uv[j * f.uv_pitch() + 2 * i + 1] = kValues[combo % n];
+        }
+    }
+}
+
+struct NV12Pattern {
+    const char* name;
+    void (*fill)(NV12TestFrame&);
+};
+
+static const NV12Pattern kPatterns[] = {
+    { "gradient", FillGradient },
+    { "noise", FillNoise },
+    { "saturated", FillSaturated },
+    { "edges", FillEdges },
+};
+
+// ---- 参考实现 ----
+
+// 逐像素定点公式，输出RGB24
+static void ReferenceRGB24(const NV12TestFrame& f, NV12ColorSpace cs, std::vector<uint8_t>& rgb) {
+    NV12FixedCoefficients k = NV12FixedColorCoefficients(cs);
+    rgb.resize(static_cast<size_t>(f.width) * f.height * 3);
+    for (int j = 0; j < f.height; j++) {
+        for (int i = 0; i < f.width; i++) {
+            const uint8_t* uv = &f.uv[(j / 2) * f.uv_pitch() + (i & ~1)];
+            int c = f.y[j * f.width + i] - k.y_offset, d = uv[0] - 128, e = uv[1] - 128;
+            uint8_t* p = &rgb[(static_cast<size_t>(j) * f.width + i) * 3];
+            p[0] = Clamp255((k.y * c + k.r_v * e + 128) >> 8);
+            p[1] = Clamp255((k.y * c + k.g_u * d + k.g_v * e + 128) >> 8);
+            p[2] = Clamp255((k.y * c + k.b_u * d + 128) >> 8);
+        }
+    }
+}
+
+// 各标准的亮度方程系数 Kr, Kb (ITU-R BT.601 / BT.709 / BT.2020)，故意不用 nv12_color.h 的
+static const double kStandardKr[3] = { 0.299, 0.2126, 0.2627 };
+static const double kStandardKb[3] = { 0.114, 0.0722, 0.0593 };
+
+// 定点系数 (8位小数) 的期望值: 由上面的 Kr/Kb 手算 round(256 * 系数)，按 [matrix][range] 排列，
+// 顺序为 y, r_v, g_u, g_v, b_u
+static const int kGoldenCoefficients[3][2][5] = {
+    { { 298, 409, -100, -208, 516 }, { 256, 359, -88, -183, 454 } },   // BT.601 limited / full
+    { { 298, 459, -55, -136, 541 }, { 256, 403, -48, -120, 475 } },    // BT.709
+    { { 298, 430, -48, -167, 548 }, { 256, 377, -42, -146, 482 } },    // BT.2020
+};
+
+// 定点参考与浮点公式允许的最大差 (8位量化的舍入)
+static const int kFloatTolerance = 1;
+
+// 浮点公式 (四舍五入)，按标准的定义直接推导: 先归一化为 Y' (0~1) 和 Pb/Pr (-0.5~0.5)，
+// R = Y' + 2(1-Kr)Pr，B = Y' + 2(1-Kb)Pb，G 由亮度方程 Y' = Kr R + Kg G + Kb B 解出
+static void FloatRGB24(const NV12TestFrame& f, NV12ColorSpace cs, std::vector<uint8_t>& rgb) {
+    double kr = kStandardKr[static_cast<int>(cs.matrix)], kb = kStandardKb[static_cast<int>(cs.matrix)], kg = 1.0 - kr - kb;
+    bool limited = cs.range == NV12Range::Limited;
+    double y_black = limited ? 16.0 : 0.0, y_range = limited ? 219.0 : 255.0, c_range = limited ? 224.0 : 255.0;
+    rgb.resize(static_cast<size_t>(f.width) * f.height * 3);
+    auto round255 = [](double v) { return static_cast<uint8_t>(std::lround(std::min(std::max(v * 255.0, 0.0), 255.0))); };
+    for (int j = 0; j < f.height; j++) {
+        for (int i = 0; i < f.width; i++) {
+            const uint8_t* uv = &f.uv[(j / 2) * f.uv_pitch() + (i & ~1)];
+            double y = (f.y[j * f.width + i] - y_black) / y_range, pb = (uv[0] - 128) / c_range, pr = (uv[1] - 128) / c_range;
+            double r = y + 2.0 * (1.0 - kr) * pr, b = y + 2.0 * (1.0 - kb) * pb, g = (y - kr * r - kb * b) / kg;
+            uint8_t* p = &rgb[(static_cast<size_t>(j) * f.width + i) * 3];
+            p[0] = round255(r);
+            p[1] = round255(g);
+            p[2] = round255(b);
+        }
+    }
+}
+
+// RGB24 -> 指定输出格式，与内核的存储代码各自独立实现
+static void PackReference(const std::vector<uint8_t>& rgb, int width, int height, NV12PixelFormat format,
+                          std::vector<uint8_t>& out) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    out.assign(pixels * NV12BytesPerPixel(format), 0);
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+        uint8_t* d = &out[i * NV12PixelStride(format)];
+        switch (format) {
+        case NV12PixelFormat::RGB24: d[0] = r; d[1] = g; d[2] = b; break;
+        case NV12PixelFormat::BGR24: d[0] = b; d[1] = g; d[2] = r; break;
+        case NV12PixelFormat::RGBA32: d[0] = r; d[1] = g; d[2] = b; d[3] = 255; break;
+        case NV12PixelFormat::BGRA32: d[0] = b; d[1] = g; d[2] = r; d[3] = 255; break;
+        case NV12PixelFormat::ARGB32: d[0] = 255; d[1] = r; d[2] = g; d[3] = b; break;
+        case NV12PixelFormat::RGB565: {
+            uint16_t v = static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            d[0] = static_cast<uint8_t>(v);
+            d[1] = static_cast<uint8_t>(v >> 8);
+            break;
+        }
+        case NV12PixelFormat::RGBPlanar: d[0] = r; d[pixels] = g; d[2 * pixels] = b; break;
+        }
+    }
+}
+
+// ---- 误差统计 ----
+
+struct NV12ErrorStats {
+    size_t mismatches = 0;
+    int max_abs = 0;
+    double mean_abs = 0;
+    double psnr = INFINITY;
+};
+
+static NV12ErrorStats CompareBytes(const uint8_t* a, const uint8_t* b, size_t size) {
+    NV12ErrorStats s;
+    double sum = 0, sum_sq = 0;
+    for (size_t i = 0; i < size; i++) {
+        int diff = std::abs(a[i] - b[i]);
+        if (diff) s.mismatches++;
+        s.max_abs = std::max(s.max_abs, diff);
+        sum += diff;
+        sum_sq += static_cast<double>(diff) * diff;
+    }
+    if (size > 0) s.mean_abs = sum / size;
+    if (sum_sq > 0) s.psnr = 10.0 * std::log10(255.0 * 255.0 * size / sum_sq);
+    return s;
+}
+
+// ---- CPU 后端 ----
+
+// 一个CPU后端: 把 frame 转换成 format，输出紧凑排列 (行距 = 宽度 * 像素步长)
+struct NV12CpuBackend {
+    std::string name;
+    std::function<void(const NV12TestFrame&, NV12ColorSpace, NV12PixelFormat, uint8_t*)> convert;
+};
+
+static std::vector<NV12CpuBackend> CpuBackends() {
+    std::vector<NV12CpuBackend> backends;
+    for (const NV12Kernel& kernel : kNV12Kernels) {
+        if (!kernel.supported()) continue;
+        const NV12Kernel* k = &kernel;
+        backends.push_back({ kernel.name, [k](const NV12TestFrame& f, NV12ColorSpace cs, NV12PixelFormat format, uint8_t* dst) {
+            NV12ToRGBRows(f.y.data(), f.width, f.uv.data(), f.uv_pitch(), f.width, f.height, 0, f.height,
+                          dst, f.width * NV12PixelStride(format), cs, format, *k);
+        } });
+    }
+    // 多线程版本用奇数条带高度 (会取偶) 和不整除的线程数，检查条带边界
+    backends.push_back({ std::string("parallel:3 (") + g_nv12_kernel.name + ")",
+                         [](const NV12TestFrame& f, NV12ColorSpace cs, NV12PixelFormat format, uint8_t* dst) {
+        NV12ParallelOptions options;
+        options.threads = 3;
+        options.band_height = 5;
+        NV12ToRGBParallel(f.y.data(), f.width, f.uv.data(), f.uv_pitch(), f.width, f.height,
+                          dst, f.width * NV12PixelStride(format), options, cs, format);
+    } });
+    return backends;
+}
+
+// 所有CPU后端 x 图样 x 尺寸 x 颜色空间 x 输出格式，与参考实现逐字节比较，返回不一致的组合数
+static int CheckCpuBackends() {
+    // 640x480 之外再加几个奇数和不满一个SIMD宽度的尺寸，覆盖行尾处理
+    static const int kSizes[][2] = { { 640, 480 }, { 1, 1 }, { 2, 2 }, { 33, 7 }, { 127, 9 }, { 1921, 3 } };
+    std::vector<NV12CpuBackend> backends = CpuBackends();
+    int failures = 0;
+
+    printf("CPU backends vs fixed-point reference (bit-exact required):\n");
+    for (const NV12CpuBackend& backend : backends) {
+        int checked = 0, bad = 0;
+        for (const NV12Pattern& pattern : kPatterns) {
+            for (const auto& size : kSizes) {
+                NV12TestFrame frame(size[0], size[1]);
+                pattern.fill(frame);
+                for (int m = 0; m < 3; m++) {
+                    for (int r = 0; r < 2; r++) {
+                        NV12ColorSpace cs;
+                        cs.matrix = static_cast<NV12Matrix>(m);
+                        cs.range = static_cast<NV12Range>(r);
+                        std::vector<uint8_t> rgb;
+                        ReferenceRGB24(frame, cs, rgb);
+                        for (int fi = 0; fi < kNV12PixelFormatCount; fi++) {
+                            NV12PixelFormat format = static_cast<NV12PixelFormat>(fi);
+                            std::vector<uint8_t> expected;
+                            PackReference(rgb, frame.width, frame.height, format, expected);
+                            // 多分配一点并填上标记，检查是否越界写
+                            std::vector<uint8_t> actual(expected.size() + 64, 0xA5);
+                            backend.convert(frame, cs, format, actual.data());
+                            NV12ErrorStats s = CompareBytes(expected.data(), actual.data(), expected.size());
+                            bool overrun = std::any_of(actual.begin() + expected.size(), actual.end(),
+                                                       [](uint8_t v) { return v != 0xA5; });
+                            checked++;
+                            if (s.mismatches || overrun) {
+                                if (bad < 5) {
+                                    printf("  MISMATCH %s %s %dx%d %s %s %s: %zu bytes differ, max abs %d%s\n",
+                                           backend.name.c_str(), pattern.name, frame.width, frame.height,
+                                           NV12MatrixName(cs.matrix), NV12RangeName(cs.range), NV12PixelFormatName(format),
+                                           s.mismatches, s.max_abs, overrun ? ", wrote past end" : "");
+                                }
+                                bad++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        printf("  %-24s %5d cases, %s\n", backend.name.c_str(), checked, bad ? "FAILED" : "bit-exact");
+        failures += bad;
+    }
+    return failures;
+}
+
+// 定点系数与 kGoldenCoefficients 比较，返回不一致的颜色空间数
+static int CheckGoldenCoefficients() {
+    int failures = 0;
+    printf("Fixed-point coefficients vs golden values:\n");
+    for (int m = 0; m < 3; m++) {
+        for (int r = 0; r < 2; r++) {
+            NV12ColorSpace cs;
+            cs.matrix = static_cast<NV12Matrix>(m);
+            cs.range = static_cast<NV12Range>(r);
+            NV12FixedCoefficients k = NV12FixedColorCoefficients(cs);
+            const int actual[5] = { k.y, k.r_v, k.g_u, k.g_v, k.b_u };
+            const int* golden = kGoldenCoefficients[m][r];
+            bool ok = std::equal(actual, actual + 5, golden) && k.y_offset == (r == 0 ? 16 : 0);
+            printf("  %-6s %-7s %4d %4d %4d %4d %4d  %s\n", NV12MatrixName(cs.matrix), NV12RangeName(cs.range),
+                   actual[0], actual[1], actual[2], actual[3], actual[4], ok ? "ok" : "MISMATCH");
+            if (!ok) failures++;
+        }
+    }
+    return failures;
+}
+
+// 定点参考与浮点公式的差距，每个颜色空间一行，超过 kFloatTolerance 的颜色空间数作为失败返回
+static int CheckFixedPointError() {
+    int failures = 0;
+    printf("Fixed-point reference vs float formula (RGB24, 640x480, max abs <= %d required):\n", kFloatTolerance);
+    for (int m = 0; m < 3; m++) {
+        for (int r = 0; r < 2; r++) {
+            NV12ColorSpace cs;
+            cs.matrix = static_cast<NV12Matrix>(m);
+            cs.range = static_cast<NV12Range>(r);
+            int max_abs = 0;
+            double min_psnr = INFINITY;
+            for (const NV12Pattern& pattern : kPatterns) {
+                NV12TestFrame frame(640, 480);
+                pattern.fill(frame);
+                std::vector<uint8_t> fixed, ideal;
+                ReferenceRGB24(frame, cs, fixed);
+                FloatRGB24(frame, cs, ideal);
+                NV12ErrorStats s = CompareBytes(ideal.data(), fixed.data(), fixed.size());
+                max_abs = std::max(max_abs, s.max_abs);
+                min_psnr = std::min(min_psnr, s.psnr);
+            }
+            printf("  %-6s %-7s max abs %d, PSNR %.2f dB%s\n", NV12MatrixName(cs.matrix), NV12RangeName(cs.range),
+                   max_abs, min_psnr, max_abs > kFloatTolerance ? "  FAILED" : "");
+            if (max_abs > kFloatTolerance) failures++;
+        }
+    }
+    return failures;
+}
+
+// ---- 其他后端 (GPU) ----
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+// 其他后端输出的格式
+//   rgb24:       每像素3字节 (nv12_gbm_egl 的 output.rgb)
+//   rgba/bgra:   每像素4字节，A忽略 (vulkanDemo 的 rgba/bgra 输出)
+//   rgbf32:      R、G、B三个float平面，0~1，按 round(v * 255) 量化后比较 (vulkanDemo 的 rgbf32 输出)
+enum class NV12ExternalFormat { RGB24, RGBA, BGRA, RGBF32 };
+
+static bool ParseExternalFormat(const char* name, NV12ExternalFormat& format) {
+    static const char* const kNames[] = { "rgb24", "rgba", "bgra", "rgbf32" };
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, kNames[i]) == 0) {
+            format = static_cast<NV12ExternalFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 按 format 和行距 stride (字节，0为紧凑排列) 读出的数据转换成紧凑的RGB24
+static bool ExternalToRGB24(const std::vector<uint8_t>& data, int width, int height, NV12ExternalFormat format,
+                            size_t stride, std::vector<uint8_t>& rgb) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    rgb.resize(pixels * 3);
+    if (format == NV12ExternalFormat::RGBF32) {
+        // 三个平面，每个平面 height 行，行距 stride
+        if (stride == 0) stride = static_cast<size_t>(width) * sizeof(float);
+        if (stride < static_cast<size_t>(width) * sizeof(float) || data.size() < stride * height * 3) return false;
+        for (int c = 0; c < 3; c++) {
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    float v;
+                    memcpy(&v, &data[(static_cast<size_t>(c) * height + j) * stride + i * sizeof(float)], sizeof(v));
+                    rgb[(static_cast<size_t>(j) * width + i) * 3 + c] =
+                        static_cast<uint8_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 255.0f));
+                }
+            }
+        }
+        return true;
+    }
+    int bpp = format == NV12ExternalFormat::RGB24 ? 3 : 4;
+    if (stride == 0) stride = static_cast<size_t>(width) * bpp;
+    if (stride < static_cast<size_t>(width) * bpp || data.size() < stride * (height - 1) + static_cast<size_t>(width) * bpp) {
+        return false;
+    }
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            const uint8_t* s = &data[j * stride + static_cast<size_t>(i) * bpp];
+            uint8_t* d = &rgb[(static_cast<size_t>(j) * width + i) * 3];
+            bool bgr = format == NV12ExternalFormat::BGRA;
+            d[0] = s[bgr ? 2 : 0];
+            d[1] = s[1];
+            d[2] = s[bgr ? 0 : 2];
+        }
+    }
+    return true;
+}
+
+// 比较其他程序的输出 (如 nv12_gbm_egl 的 output.rgb、vulkanDemo 的RGB输出) 与参考实现，按通道报告误差
+static int CompareExternal(const char* rgb_path, const char* nv12_path, int width, int height, NV12ColorSpace cs,
+                           NV12ExternalFormat format, size_t stride, bool flip) {
+    std::vector<uint8_t> nv12, data, rgb;
+    if (!ReadFile(nv12_path, nv12) || nv12.size() < NV12FrameSize(width, height)) {
+        fprintf(stderr, "Failed to read %dx%d NV12 from %s\n", width, height, nv12_path);
+        return -1;
+    }
+    size_t rgb_size = static_cast<size_t>(width) * height * 3;
+    if (!ReadFile(rgb_path, data) || !ExternalToRGB24(data, width, height, format, stride, rgb)) {
+        fprintf(stderr, "Failed to read %dx%d RGB from %s (file too short for the format and stride)\n", width, height,
+                rgb_path);
+        return -1;
+    }
+    if (flip) {
+        for (int j = 0; j < height / 2; j++) {
+            std::swap_ranges(rgb.begin() + static_cast<size_t>(j) * width * 3,
+                             rgb.begin() + static_cast<size_t>(j + 1) * width * 3,
+                             rgb.begin() + static_cast<size_t>(height - 1 - j) * width * 3);
+        }
+    }
+
+    NV12TestFrame frame(width, height);
+    memcpy(frame.y.data(), nv12.data(), frame.y.size());
+    memcpy(frame.uv.data(), nv12.data() + frame.y.size(), frame.uv.size());
+    std::vector<uint8_t> expected;
+    ReferenceRGB24(frame, cs, expected);
+
+    printf("%s vs reference (%s %s, %dx%d):\n", rgb_path, NV12MatrixName(cs.matrix), NV12RangeName(cs.range), width,
+           height);
+    static const char* kChannels[] = { "R", "G", "B" };
+    for (int c = 0; c < 3; c++) {
+        std::vector<uint8_t> a(static_cast<size_t>(width) * height), b(a.size());
+        for (size_t i = 0; i < a.size(); i++) {
+            a[i] = expected[i * 3 + c];
+            b[i] = rgb[i * 3 + c];
+        }
+        NV12ErrorStats s = CompareBytes(a.data(), b.data(), a.size());
+        printf("  %s: max abs %3d, mean abs %.4f, PSNR %6.2f dB, %5.2f%% of pixels differ\n", kChannels[c], s.max_abs,
+               s.mean_abs, s.psnr, 100.0 * s.mismatches / a.size());
+    }
+    NV12ErrorStats all = CompareBytes(expected.data(), rgb.data(), rgb_size);
+    printf("  all: max abs %3d, mean abs %.4f, PSNR %6.2f dB\n", all.max_abs, all.mean_abs, all.psnr);
+    return 0;
+}
+
+static int WritePatterns(const char* dir) {
+    const int width = 640, height = 480;
+    for (const NV12Pattern& pattern : kPatterns) {
+        NV12TestFrame frame(width, height);
+        pattern.fill(frame);
+        std::string path = std::string(dir) + "/" + pattern.name + ".nv12";
+        FILE* f = fopen(path.c_str(), "wb");
+        bool ok = f && fwrite(frame.y.data(), 1, frame.y.size(), f) == frame.y.size() &&
+                  fwrite(frame.uv.data(), 1, frame.uv.size(), f) == frame.uv.size();
+        if (f && fclose(f) != 0) ok = false;
+        if (!ok) {
+            fprintf(stderr, "Failed to write %s\n", path.c_str());
+            return -1;
+        }
+        printf("Wrote %s (%dx%d)\n", path.c_str(), width, height);
+    }
+    return 0;
+}
+
+static void PrintUsage(const char* prog) {
+    printf("Usage: %s                      check all CPU backends against the reference\n", prog);
+    printf("       %s --write=DIR          write the test patterns as DIR/<pattern>.nv12 (640x480)\n", prog);
+    printf("       %s --compare=RGB_FILE [--format=rgb24|rgba|bgra|rgbf32] [--stride=BYTES] [--flip]\n", prog);
+    printf("          [--matrix=bt601|bt709|bt2020] [--range=limited|full] input_nv12_file width height\n");
+    printf("                               report max/mean abs error and PSNR of another backend's RGB output\n");
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<const char*> args;
+    NV12ColorSpace color_space;
+    const char* write_dir = nullptr;
+    const char* compare_file = nullptr;
+    bool flip = false;
+    NV12ExternalFormat compare_format = NV12ExternalFormat::RGB24;
+    long compare_stride = 0;
+    for (int i = 1; i < argc; i++) {
+        bool ok = true;
+        if (strncmp(argv[i], "--write=", 8) == 0) {
+            write_dir = argv[i] + 8;
+        } else if (strncmp(argv[i], "--compare=", 10) == 0) {
+            compare_file = argv[i] + 10;
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            ok = ParseExternalFormat(argv[i] + 9, compare_format);
+        } else if (strncmp(argv[i], "--stride=", 9) == 0) {
+            compare_stride = atol(argv[i] + 9);
+            ok = compare_stride > 0;
+        } else if (strcmp(argv[i], "--flip") == 0) {
+            flip = true;
+        } else if (strncmp(argv[i], "--matrix=", 9) == 0) {
+            ok = NV12ParseColorSpace(argv[i] + 9, nullptr, color_space);
+        } else if (strncmp(argv[i], "--range=", 8) == 0) {
+            ok = NV12ParseColorSpace(nullptr, argv[i] + 8, color_space);
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            ok = false;
+        } else {
+            args.push_back(argv[i]);
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid option %s\n", argv[i]);
+            PrintUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (write_dir) return WritePatterns(write_dir);
+    if (compare_file) {
+        if (args.size() != 3 || atoi(args[1]) <= 0 || atoi(args[2]) <= 0) {
+            PrintUsage(argv[0]);
+            return -1;
+        }
+        return CompareExternal(compare_file, args[0], atoi(args[1]), atoi(args[2]), color_space, compare_format,
+                               static_cast<size_t>(compare_stride), flip);
+    }
+    if (!args.empty()) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    int failures = CheckCpuBackends();
+    failures += CheckGoldenCoefficients();
+    failures += CheckFixedPointError();
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
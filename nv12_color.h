@@ -0,0 +1,136 @@
+// nv12_color.h
+// NV12 (YUV) -> RGB 的颜色空间描述，CPU转换 (nv12_to_rgb.cpp) 和
+// GLES着色器 (nv12_to_rgb_gl.cpp, nv12_gbm_egl.cpp) 共用同一套系数，保证各后端输出一致。
+//
+//   matrix: BT.601 (SD) / BT.709 (HD) / BT.2020 (UHD)
+//   range:  limited (Y 16~235, UV 16~240) / full (0~255)
+//
+// 默认 BT.601 limited，与解码器输出的大多数NV12一致。
+
+#ifndef NV12_COLOR_H
+#define NV12_COLOR_H
+
+#include <cstring>
+
+enum class NV12Matrix { BT601, BT709, BT2020 };
+enum class NV12Range { Limited, Full };
+
+struct NV12ColorSpace {
+    NV12Matrix matrix = NV12Matrix::BT601;
+    NV12Range range = NV12Range::Limited;
+};
+
+// 浮点系数，输入为0~255的YUV值:
+//   R = y * (Y - y_offset) + r_v * (V - 128)
+//   G = y * (Y - y_offset) + g_u * (U - 128) + g_v * (V - 128)
+//   B = y * (Y - y_offset) + b_u * (U - 128)
+struct NV12FloatCoefficients {
+    int y_offset;
+    double y;
+    double r_v;
+    double g_u;
+    double g_v;
+    double b_u;
+};
+
+// 定点系数 (8位小数)，由浮点系数在编译期四舍五入得到，CPU转换使用
+struct NV12FixedCoefficients {
+    int y_offset;
+    int y;
+    int r_v;
+    int g_u;
+    int g_v;
+    int b_u;
+};
+
+constexpr NV12FloatCoefficients NV12ColorCoefficients(NV12ColorSpace cs) {
+    // Kr, Kb 来自各标准的亮度方程
+    double kr = cs.matrix == NV12Matrix::BT709 ? 0.2126 : cs.matrix == NV12Matrix::BT2020 ? 0.2627 : 0.299;
+    double kb = cs.matrix == NV12Matrix::BT709 ? 0.0722 : cs.matrix == NV12Matrix::BT2020 ? 0.0593 : 0.114;
+    double kg = 1.0 - kr - kb;
+    bool limited = cs.range == NV12Range::Limited;
+    double y_scale = limited ? 255.0 / 219.0 : 1.0;
+    double c_scale = limited ? 255.0 / 224.0 : 1.0;
+    return NV12FloatCoefficients{
+        limited ? 16 : 0,
+        y_scale,
+        2.0 * (1.0 - kr) * c_scale,
+        -2.0 * kb * (1.0 - kb) / kg * c_scale,
+        -2.0 * kr * (1.0 - kr) / kg * c_scale,
+        2.0 * (1.0 - kb) * c_scale,
+    };
+}
+
+constexpr int NV12RoundFixed(double v) {
+    return v >= 0 ? static_cast<int>(v * 256.0 + 0.5) : -static_cast<int>(-v * 256.0 + 0.5);
+}
+
+constexpr NV12FixedCoefficients NV12FixedColorCoefficients(NV12ColorSpace cs) {
+    NV12FloatCoefficients f = NV12ColorCoefficients(cs);
+    return NV12FixedCoefficients{
+        f.y_offset,
+        NV12RoundFixed(f.y),
+        NV12RoundFixed(f.r_v),
+        NV12RoundFixed(f.g_u),
+        NV12RoundFixed(f.g_v),
+        NV12RoundFixed(f.b_u),
+    };
+}
+
+// BT.601 limited 必须得到原来硬编码的 298/409/-100/-208/516
+static_assert(NV12FixedColorCoefficients(NV12ColorSpace()).y == 298 &&
+              NV12FixedColorCoefficients(NV12ColorSpace()).r_v == 409 &&
+              NV12FixedColorCoefficients(NV12ColorSpace()).g_u == -100 &&
+              NV12FixedColorCoefficients(NV12ColorSpace()).g_v == -208 &&
+              NV12FixedColorCoefficients(NV12ColorSpace()).b_u == 516,
+              "BT.601 limited fixed-point coefficients changed");
+
+// 着色器uniform: rgb = matrix * (texel.yuv - offset)，texel为归一化到0~1的采样值
+//   offset: vec3 (uniform yuvOffset)
+//   matrix: mat3，列主序，可直接传给 glUniformMatrix3fv(loc, 1, GL_FALSE, matrix)
+struct NV12ColorUniforms {
+    float offset[3];
+    float matrix[9];
+};
+
+constexpr NV12ColorUniforms NV12ColorShaderUniforms(NV12ColorSpace cs) {
+    NV12FloatCoefficients f = NV12ColorCoefficients(cs);
+    return NV12ColorUniforms{
+        { static_cast<float>(f.y_offset / 255.0), static_cast<float>(128.0 / 255.0), static_cast<float>(128.0 / 255.0) },
+        {
+            static_cast<float>(f.y), static_cast<float>(f.y), static_cast<float>(f.y),   // Y 列
+            0.0f, static_cast<float>(f.g_u), static_cast<float>(f.b_u),                   // U 列
+            static_cast<float>(f.r_v), static_cast<float>(f.g_v), 0.0f,                   // V 列
+        },
+    };
+}
+
+// 着色器中使用的声明和转换表达式，GLSL ES 1.00 / 3.00 通用
+#define NV12_GLSL_COLOR_UNIFORMS "uniform vec3 yuvOffset;\nuniform mat3 yuvMatrix;\n"
+#define NV12_GLSL_COLOR_CONVERT(yuv) "clamp(yuvMatrix * (" yuv " - yuvOffset), 0.0, 1.0)"
+
+inline const char* NV12MatrixName(NV12Matrix m) {
+    return m == NV12Matrix::BT709 ? "bt709" : m == NV12Matrix::BT2020 ? "bt2020" : "bt601";
+}
+
+inline const char* NV12RangeName(NV12Range r) {
+    return r == NV12Range::Full ? "full" : "limited";
+}
+
+// 解析命令行参数: matrix 为 bt601/bt709/bt2020，range 为 limited/full，传NULL表示保持不变
+inline bool NV12ParseColorSpace(const char* matrix, const char* range, NV12ColorSpace& cs) {
+    if (matrix) {
+        if (strcmp(matrix, "bt601") == 0) cs.matrix = NV12Matrix::BT601;
+        else if (strcmp(matrix, "bt709") == 0) cs.matrix = NV12Matrix::BT709;
+        else if (strcmp(matrix, "bt2020") == 0) cs.matrix = NV12Matrix::BT2020;
+        else return false;
+    }
+    if (range) {
+        if (strcmp(range, "limited") == 0) cs.range = NV12Range::Limited;
+        else if (strcmp(range, "full") == 0) cs.range = NV12Range::Full;
+        else return false;
+    }
+    return true;
+}
+
+#endif // NV12_COLOR_H
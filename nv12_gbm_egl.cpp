@@ -4,7 +4,7 @@
 // g++ nv12_gbm_egl.cpp -o nv12_gbm_egl -lEGL -lGLESv2 -lX11 -lgbm -ldrm
 //
 // Run (ensure test_nv12.yuv 640x480 exists and you have permission to /dev/dri/renderD128):
-// ./nv12_gbm_egl
+// ./nv12_gbm_egl [bt601|bt709|bt2020] [limited|full]     (default: bt601 limited)
 //
 // Output: output.rgb (RGB24 raw)
 
@@ -30,6 +30,8 @@
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#include "nv12_color.h"
+
 #ifndef DRM_FORMAT_NV12
 #define DRM_FORMAT_NV12 DRM_FORMAT_NV12
 #endif
@@ -58,18 +60,15 @@ static const char* fs_src =
 "varying vec2 vTex;\n"
 "uniform sampler2D texY;\n"
 "uniform sampler2D texUV;\n"
+NV12_GLSL_COLOR_UNIFORMS
 "void main(){\n"
 "   float y = texture2D(texY, vTex).r;\n" // Y in R
 "   // NV12 UV is interleaved as (U,V). We upload as GL_LUMINANCE_ALPHA,\n"
 "   // where L -> RGB, A -> alpha. So fetch U from .r (L) and V from .a (alpha).\n"
 "   vec2 uv = texture2D(texUV, vTex).ra;\n" // U in .r (L), V in .a (alpha)
-"   float u = uv.x - 0.5;\n"
-"   float v = uv.y - 0.5;\n"
-"   // Assume full-range YUV. If your source is limited-range, enable the offset/scale.\n"
-"   float r = y + 1.402 * v;\n"
-"   float g = y - 0.344136 * u - 0.714136 * v;\n"
-"   float b = y + 1.772 * u;\n"
-"   gl_FragColor = vec4(r,g,b,1.0);\n"
+"   // matrix/range come from the yuvOffset/yuvMatrix uniforms (see nv12_color.h)\n"
+"   vec3 yuv = vec3(y, uv);\n"
+"   gl_FragColor = vec4(" NV12_GLSL_COLOR_CONVERT("yuv") ", 1.0);\n"
 "}\n";
 
 static GLuint compile_shader(GLenum type, const char* src) {
@@ -111,7 +110,13 @@ static int egl_has_ext(EGLDisplay dpy, const char* name) {
     return strstr(s, name) != NULL;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    NV12ColorSpace color_space;
+    if (!NV12ParseColorSpace(argc > 1 ? argv[1] : NULL, argc > 2 ? argv[2] : NULL, color_space)) {
+        fprintf(stderr, "Usage: %s [bt601|bt709|bt2020] [limited|full]\n", argv[0]);
+        return 1;
+    }
+
     // 1. read test NV12 file
     size_t y_size = WIDTH * HEIGHT;
     size_t uv_size = WIDTH * HEIGHT / 2;
@@ -317,6 +322,10 @@ int main() {
     GLint locUV = glGetUniformLocation(prog, "texUV");
     glUniform1i(locY, 0);
     glUniform1i(locUV, 1);
+    // same coefficients as the CPU converter (nv12_to_rgb.cpp)
+    NV12ColorUniforms color = NV12ColorShaderUniforms(color_space);
+    glUniform3fv(glGetUniformLocation(prog, "yuvOffset"), 1, color.offset);
+    glUniformMatrix3fv(glGetUniformLocation(prog, "yuvMatrix"), 1, GL_FALSE, color.matrix);
 
     // vertex data
     float verts[] = {
@@ -1,84 +1,2211 @@
+// nv12_to_rgb.cpp
+// Build:
+// g++ -O2 -std=c++17 -pthread nv12_to_rgb.cpp -o nv12_to_rgb
+//
+// Run:
+// ./nv12_to_rgb [--matrix=bt601|bt709|bt2020] [--range=limited|full] [--format=...] [--output=FILE] [--stream]
+//               input_nv12_file width height [threads] [band_height]
+//
+// Output: output.rgb (raw, layout chosen by --format, default RGB24)
+//
+// Streaming: --stream converts every frame of a concatenated NV12 capture; "-" reads stdin / writes stdout, e.g.
+// cat capture.nv12 | ./nv12_to_rgb --stream --output=- - 1920 1080 | ffmpeg -f rawvideo -pix_fmt rgb24 -s 1920x1080 -i - out.mp4
+//
+// Large files: --io=uring keeps several frame reads/writes in flight with io_uring (Linux, regular files only), e.g.
+// ./nv12_to_rgb --stream --io=uring --output=capture.rgb capture.nv12 1920 1080
+
 #include <iostream>
-#include <fstream>
+#include <cstdio>
 #include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "nv12_color.h"
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NV12_HAVE_MMAP 1
+#endif
+
+// io_uring 直接用系统调用，不依赖 liburing，只需要内核头文件
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define NV12_HAVE_IO_URING 1
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+// GCC 12 的 _mm512_undefined_* 在内联后会误报 -Wuninitialized (GCC PR105593，13 已修复)，只对头文件本身关掉
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ == 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
+#define NV12_HAVE_X86 1
+#define NV12_TARGET_SSE41 __attribute__((target("ssse3,sse4.1")))
+#define NV12_TARGET_AVX2 __attribute__((target("avx2")))
+#define NV12_TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+#endif
+
+// 行对转换函数: 同时转换共用一行UV的两行Y (2x2块共用一组UV)，每行width个像素
+//   y_row0, y_row1: 第 j 行和第 j+1 行的Y数据
+//   uv_row: 两行共用的UV交织数据 (第 j/2 行)
+//   rgb_row0, rgb_row1: 两行输出数据 (格式由内核实例决定，平面格式时为R平面的行)
+// 高度为奇数时最后一行单独成对，y_row1/rgb_row1 与 y_row0/rgb_row0 相同
+//   plane_stride: 平面格式中相邻两个平面之间的字节数，打包格式不使用
+//   p: 运行时才能确定的颜色空间参数 (查找表)，系数本身在编译期展开到每个内核里
+struct NV12ColorParams;
+typedef void (*NV12RowPairFunc)(const uint8_t* y_row0, const uint8_t* y_row1, const uint8_t* uv_row,
+                                uint8_t* rgb_row0, uint8_t* rgb_row1, int width, ptrdiff_t plane_stride,
+                                const NV12ColorParams& p);
+
+static inline uint8_t Clamp255(int v) {
+    return static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+}
+
+// ---- 颜色空间参数 ----
+//
+// 定点系数 (8位小数) 由 nv12_color.h 在编译期生成。SIMD实现为了在16位整数内得到与
+// 标量版本完全一致的结果，把每个系数 k 拆成 256*q + r (r 取 [-128, 128) 内):
+// 因为 256*q*x 是256的整数倍，(256*q*x + rest) >> 8 == q*x + (rest >> 8)。
+// 例如 BT.601 limited: 298 = 256 + 42, 409 = 512 - 103, -208 = -256 + 48, 516 = 512 + 4。
+// 于是每个通道 = C + add + ((r_y*C + rest) >> 8)，其中
+//   add  = q_u*D + q_v*E
+//   rest = r_u*D + r_v*E + 128
+// 只依赖UV。下面的 static_assert 保证所有颜色空间的 rest 项都不会溢出int16。
+
+struct NV12SplitChannel {
+    int q_u, q_v;
+    int r_u, r_v;
+};
+
+struct NV12SplitCoefficients {
+    int r_y;                  // 亮度系数的 q 固定为1 (见下面的static_assert)
+    NV12SplitChannel ch[3];   // R, G, B
+};
+
+constexpr int FloorDiv256(int v) {
+    return v >= 0 ? v / 256 : -((-v + 255) / 256);
+}
+
+constexpr int SplitQ(int k) { return FloorDiv256(k + 128); }
+constexpr int SplitR(int k) { return k - 256 * SplitQ(k); }
+
+constexpr NV12SplitChannel SplitChannel(int u, int v) {
+    return NV12SplitChannel{ SplitQ(u), SplitQ(v), SplitR(u), SplitR(v) };
+}
+
+constexpr NV12SplitCoefficients SplitCoefficients(const NV12FixedCoefficients& k) {
+    return NV12SplitCoefficients{
+        SplitR(k.y),
+        { SplitChannel(0, k.r_v), SplitChannel(k.g_u, k.g_v), SplitChannel(k.b_u, 0) },
+    };
+}
+
+// r*x 在 x∈[lo, hi] 上的最大/最小值
+constexpr int TermMax(int r, int lo, int hi) { return r >= 0 ? r * hi : r * lo; }
+constexpr int TermMin(int r, int lo, int hi) { return r >= 0 ? r * lo : r * hi; }
+
+constexpr bool SplitFitsInt16(NV12ColorSpace cs) {
+    NV12FixedCoefficients k = NV12FixedColorCoefficients(cs);
+    NV12SplitCoefficients s = SplitCoefficients(k);
+    if (SplitQ(k.y) != 1) return false;
+    int c_lo = -k.y_offset, c_hi = 255 - k.y_offset;
+    for (const NV12SplitChannel& ch : s.ch) {
+        int hi = TermMax(s.r_y, c_lo, c_hi) + TermMax(ch.r_u, -128, 127) + TermMax(ch.r_v, -128, 127) + 128;
+        int lo = TermMin(s.r_y, c_lo, c_hi) + TermMin(ch.r_u, -128, 127) + TermMin(ch.r_v, -128, 127) + 128;
+        if (hi > 32767 || lo < -32768) return false;
+    }
+    return true;
+}
+
+constexpr bool AllSplitsFitInt16() {
+    for (NV12Matrix m : { NV12Matrix::BT601, NV12Matrix::BT709, NV12Matrix::BT2020 }) {
+        for (NV12Range r : { NV12Range::Limited, NV12Range::Full }) {
+            NV12ColorSpace cs;
+            cs.matrix = m;
+            cs.range = r;
+            if (!SplitFitsInt16(cs)) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(AllSplitsFitInt16(), "split fixed-point coefficients overflow int16 in the SIMD kernels");
+
+// 查表实现用的表: 用按分量的查找表代替 y*C, r_v*E, g_u*D, g_v*E, b_u*D 乘法，
+// 用于乘法很慢的低端CPU (如Atom) 上和算术版本做对比
+//
+// 表项存的就是标量公式里的乘积，相加后移位，结果与算术版本逐字节一致。
+// 298*C 最大为 298*239 = 71222，409*127 = 51943，超出int16，所以表项用int32。
+// 换成 256*q + r 拆分后的int16表，每个乘积要查 q*x 和 r*x 两张表 (总大小不变，还多一次查表和加法)，
+// 所以不拆: 5张int32表加截断表共6KB，一个颜色空间的表远小于L1。
+// 截断也用查表: 所有颜色空间下 (sum >> 8) 的范围都在 [-384, 640) 内 (见下面的static_assert)，
+// 加上 kClampOffset 后作为下标。
+struct NV12LookupTables {
+    static const int kClampOffset = 384;
+    int32_t y[256];     // y * (Y - y_offset) + 128 (含舍入项)
+    int32_t r_v[256];   // r_v * (V - 128)
+    int32_t g_u[256];   // g_u * (U - 128)
+    int32_t g_v[256];   // g_v * (V - 128)
+    int32_t b_u[256];   // b_u * (U - 128)
+    uint8_t clamp[1024];
+};
+
+// 各通道 (sum >> 8) 的范围必须落在截断表 [-kClampOffset, 1024 - kClampOffset) 内
+constexpr bool LookupClampFits(NV12ColorSpace cs, int offset, int size) {
+    NV12FixedCoefficients k = NV12FixedColorCoefficients(cs);
+    int c_lo = -k.y_offset, c_hi = 255 - k.y_offset;
+    int y_hi = TermMax(k.y, c_lo, c_hi) + 128, y_lo = TermMin(k.y, c_lo, c_hi) + 128;
+    const int hi[3] = {
+        y_hi + TermMax(k.r_v, -128, 127),
+        y_hi + TermMax(k.g_u, -128, 127) + TermMax(k.g_v, -128, 127),
+        y_hi + TermMax(k.b_u, -128, 127),
+    };
+    const int lo[3] = {
+        y_lo + TermMin(k.r_v, -128, 127),
+        y_lo + TermMin(k.g_u, -128, 127) + TermMin(k.g_v, -128, 127),
+        y_lo + TermMin(k.b_u, -128, 127),
+    };
+    for (int c = 0; c < 3; c++) {
+        // >> 8 对负数是向下取整，FloorDiv256 与之一致
+        if (FloorDiv256(lo[c]) < -offset || FloorDiv256(hi[c]) >= size - offset) return false;
+    }
+    return true;
+}
+
+constexpr bool AllLookupClampsFit(int offset, int size) {
+    for (NV12Matrix m : { NV12Matrix::BT601, NV12Matrix::BT709, NV12Matrix::BT2020 }) {
+        for (NV12Range r : { NV12Range::Limited, NV12Range::Full }) {
+            NV12ColorSpace cs;
+            cs.matrix = m;
+            cs.range = r;
+            if (!LookupClampFits(cs, offset, size)) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(AllLookupClampsFit(NV12LookupTables::kClampOffset, sizeof(NV12LookupTables::clamp)),
+              "lookup clamp table index out of range for some color space");
+
+static NV12LookupTables BuildNV12LookupTables(const NV12FixedCoefficients& k) {
+    NV12LookupTables t;
+    for (int i = 0; i < 256; i++) {
+        t.y[i] = k.y * (i - k.y_offset) + 128;
+        t.r_v[i] = k.r_v * (i - 128);
+        t.g_u[i] = k.g_u * (i - 128);
+        t.g_v[i] = k.g_v * (i - 128);
+        t.b_u[i] = k.b_u * (i - 128);
+    }
+    for (int i = 0; i < 1024; i++) {
+        t.clamp[i] = Clamp255(i - NV12LookupTables::kClampOffset);
+    }
+    return t;
+}
+
+// 编译期系数: 每个内核按 (matrix, range) 实例化，系数作为常量折叠进代码，
+// 乘0/乘1之类的项被编译器直接消掉，也避免每像素从内存重新读取系数
+template <NV12Matrix M, NV12Range R>
+struct NV12ColorConstants {
+    static constexpr NV12FixedCoefficients k = NV12FixedColorCoefficients(NV12ColorSpace{ M, R });
+    static constexpr NV12SplitCoefficients split = SplitCoefficients(k);
+};
+
+// 运行时参数，目前只有查表实现需要
+struct NV12ColorParams {
+    NV12LookupTables lut;
+};
+
+// 每种颜色空间的查找表只在第一次使用时构建一次
+static const NV12ColorParams& GetNV12ColorParams(NV12ColorSpace cs) {
+    struct Table {
+        NV12ColorParams params[3][2];
+        Table() {
+            for (int m = 0; m < 3; m++) {
+                for (int r = 0; r < 2; r++) {
+                    NV12ColorSpace c;
+                    c.matrix = static_cast<NV12Matrix>(m);
+                    c.range = static_cast<NV12Range>(r);
+                    params[m][r].lut = BuildNV12LookupTables(NV12FixedColorCoefficients(c));
+                }
+            }
+        }
+    };
+    static const Table table;
+    return table.params[static_cast<int>(cs.matrix)][static_cast<int>(cs.range)];
+}
+
+// ---- 输出像素格式 ----
+//
+// 每个内核都按输出格式实例化，格式相关的代码在编译期展开，逐像素没有格式判断。
+//   RGB24/BGR24:           每像素3字节，按名字的顺序排列
+//   RGBA32/BGRA32/ARGB32:  每像素4字节，按名字的字节顺序排列，A固定为255
+//   RGB565:                每像素2字节，小端16位 R<<11 | G<<5 | B (取高位截断)
+//   RGBPlanar:             R、G、B三个平面，每像素每平面1字节，平面之间相隔 plane_stride 字节
+enum class NV12PixelFormat { RGB24, BGR24, RGBA32, BGRA32, ARGB32, RGB565, RGBPlanar };
+
+static const int kNV12PixelFormatCount = 7;
+
+// 第一个平面中每像素的字节数
+constexpr int NV12PixelStride(NV12PixelFormat f) {
+    return f == NV12PixelFormat::RGB24 || f == NV12PixelFormat::BGR24 ? 3
+         : f == NV12PixelFormat::RGB565 ? 2
+         : f == NV12PixelFormat::RGBPlanar ? 1
+         : 4;
+}
+
+// 每像素输出的总字节数 (所有平面)
+constexpr int NV12BytesPerPixel(NV12PixelFormat f) {
+    return f == NV12PixelFormat::RGBPlanar ? 3 : NV12PixelStride(f);
+}
+
+// 打包格式中第 pos 个字节对应的通道: 0=R 1=G 2=B 3=A
+constexpr int NV12ChannelAt(NV12PixelFormat f, int pos) {
+    return f == NV12PixelFormat::BGR24 || f == NV12PixelFormat::BGRA32 ? (pos < 3 ? 2 - pos : 3)
+         : f == NV12PixelFormat::ARGB32 ? (pos == 0 ? 3 : pos - 1)
+         : pos;
+}
+
+static const char* const kNV12PixelFormatNames[kNV12PixelFormatCount] = {
+    "rgb24", "bgr24", "rgba32", "bgra32", "argb32", "rgb565", "planar",
+};
+
+inline const char* NV12PixelFormatName(NV12PixelFormat f) {
+    return kNV12PixelFormatNames[static_cast<int>(f)];
+}
+
+inline bool NV12ParsePixelFormat(const char* name, NV12PixelFormat& f) {
+    for (int i = 0; i < kNV12PixelFormatCount; i++) {
+        if (strcmp(name, kNV12PixelFormatNames[i]) == 0) {
+            f = static_cast<NV12PixelFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 按格式写出一个像素，dst指向该像素在第一个平面中的位置
+template <NV12PixelFormat F>
+static inline void StorePixel(uint8_t r, uint8_t g, uint8_t b, uint8_t* dst, ptrdiff_t plane_stride) {
+    if constexpr (F == NV12PixelFormat::RGB565) {
+        uint16_t v = static_cast<uint16_t>((r >> 3) << 11 | (g >> 2) << 5 | (b >> 3));
+        dst[0] = static_cast<uint8_t>(v);
+        dst[1] = static_cast<uint8_t>(v >> 8);
+    } else if constexpr (F == NV12PixelFormat::RGBPlanar) {
+        dst[0] = r;
+        dst[plane_stride] = g;
+        dst[plane_stride * 2] = b;
+    } else {
+        const uint8_t ch[4] = { r, g, b, 255 };
+        for (int pos = 0; pos < NV12PixelStride(F); pos++) dst[pos] = ch[NV12ChannelAt(F, pos)];
+    }
+}
+
+// 一个像素: 色度项已经算好，只剩亮度部分
+template <NV12PixelFormat F>
+static inline void YToRGB(const NV12FixedCoefficients& k, int Y, int r_uv, int g_uv, int b_uv,
+                          uint8_t* dst, ptrdiff_t plane_stride) {
+    int y = k.y * (Y - k.y_offset) + 128;
+    StorePixel<F>(Clamp255((y + r_uv) >> 8), Clamp255((y + g_uv) >> 8), Clamp255((y + b_uv) >> 8), dst, plane_stride);
+}
+
+// 标量实现，也是所有SIMD实现的参考结果和行尾处理
+// 每组UV的色度项 (r_v*E, g_u*D+g_v*E, b_u*D) 只计算一次，供2x2共4个像素使用
+template <NV12PixelFormat F, NV12Matrix M, NV12Range R>
+static void NV12ToRGBRowPair_C(const uint8_t* y_row0, const uint8_t* y_row1, const uint8_t* uv_row,
+                               uint8_t* rgb_row0, uint8_t* rgb_row1, int width, ptrdiff_t plane_stride,
+                               const NV12ColorParams&) {
+    constexpr NV12FixedCoefficients k = NV12ColorConstants<M, R>::k;
+    constexpr int kStride = NV12PixelStride(F);
+    for (int i = 0; i < width; i += 2) {
+        int D = uv_row[i] - 128;
+        int E = uv_row[i + 1] - 128;
+        int r_uv = k.r_v * E;
+        int g_uv = k.g_u * D + k.g_v * E;
+        int b_uv = k.b_u * D;
+
+        YToRGB<F>(k, y_row0[i], r_uv, g_uv, b_uv, rgb_row0 + i * kStride, plane_stride);
+        YToRGB<F>(k, y_row1[i], r_uv, g_uv, b_uv, rgb_row1 + i * kStride, plane_stride);
+        if (i + 1 < width) {
+            YToRGB<F>(k, y_row0[i + 1], r_uv, g_uv, b_uv, rgb_row0 + (i + 1) * kStride, plane_stride);
+            YToRGB<F>(k, y_row1[i + 1], r_uv, g_uv, b_uv, rgb_row1 + (i + 1) * kStride, plane_stride);
+        }
+    }
+}
+
+template <NV12PixelFormat F>
+static inline void YToRGB_LUT(const NV12LookupTables& t, int Y, int r_uv, int g_uv, int b_uv,
+                              uint8_t* dst, ptrdiff_t plane_stride) {
+    const uint8_t* clamp = t.clamp + NV12LookupTables::kClampOffset;
+    int y = t.y[Y];
+    StorePixel<F>(clamp[(y + r_uv) >> 8], clamp[(y + g_uv) >> 8], clamp[(y + b_uv) >> 8], dst, plane_stride);
+}
+
+template <NV12PixelFormat F>
+static void NV12ToRGBRowPair_LUT(const uint8_t* y_row0, const uint8_t* y_row1, const uint8_t* uv_row,
+                                 uint8_t* rgb_row0, uint8_t* rgb_row1, int width, ptrdiff_t plane_stride,
+                                 const NV12ColorParams& p) {
+    const NV12LookupTables& t = p.lut;
+    constexpr int kStride = NV12PixelStride(F);
+    for (int i = 0; i < width; i += 2) {
+        int U = uv_row[i];
+        int V = uv_row[i + 1];
+        int r_uv = t.r_v[V];
+        int g_uv = t.g_u[U] + t.g_v[V];
+        int b_uv = t.b_u[U];
+
+        YToRGB_LUT<F>(t, y_row0[i], r_uv, g_uv, b_uv, rgb_row0 + i * kStride, plane_stride);
+        YToRGB_LUT<F>(t, y_row1[i], r_uv, g_uv, b_uv, rgb_row1 + i * kStride, plane_stride);
+        if (i + 1 < width) {
+            YToRGB_LUT<F>(t, y_row0[i + 1], r_uv, g_uv, b_uv, rgb_row0 + (i + 1) * kStride, plane_stride);
+            YToRGB_LUT<F>(t, y_row1[i + 1], r_uv, g_uv, b_uv, rgb_row1 + (i + 1) * kStride, plane_stride);
+        }
+    }
+}
+
+#ifdef NV12_HAVE_X86
+// SIMD实现 (SSE4.1 / AVX2 / AVX-512BW)
+//
+// 使用上面拆分后的系数: 每个通道 = C + add + ((r_y*C + rest) >> 8)，全部在int16内计算，
+// add/rest 按行对计算一次后复制给2x2块的4个像素。最后用饱和打包(packus)完成0~255的截断，
+// 得到按像素顺序排列的R/G/B三个字节向量，再由 StorePixels_* 按输出格式写出。
+
+// 24位格式交织用的pshufb表: 16个像素的三个通道各16字节 -> 3个16字节输出块
+// (BGR24 只是把R和B通道交换后使用同一张表)
+// SSE4.1 直接使用; pshufb 只在128位lane内查表，所以 AVX2/AVX-512 把它广播到每个lane (从AVX2内核最初版本起就是这样)
+alignas(16) static const int8_t kShuffleRGB24[3][3][16] = {
+    {   // 输出块0
+        { 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+        {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+        {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1},
+    },
+    {   // 输出块1
+        {-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+        { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+        {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1},
+    },
+    {   // 输出块2
+        {-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+        {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+        {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15},
+    },
+};
+
+// ---- SSE4.1: 每次处理2x16个Y像素和8组UV，用pshufb(SSSE3)交织RGB24输出 ----
+
+// 广播到向量的拆分系数
+struct Coeffs_SSE41 {
+    __m128i y_offset, r_y;
+    __m128i q_u[3], q_v[3], r_u[3], r_v[3];
+};
+
+template <NV12Matrix M, NV12Range R>
+NV12_TARGET_SSE41
+static inline void LoadCoeffs_SSE41(Coeffs_SSE41& k) {
+    typedef NV12ColorConstants<M, R> CC;
+    k.y_offset = _mm_set1_epi16(static_cast<int16_t>(CC::k.y_offset));
+    k.r_y = _mm_set1_epi16(static_cast<int16_t>(CC::split.r_y));
+    for (int c = 0; c < 3; c++) {
+        k.q_u[c] = _mm_set1_epi16(static_cast<int16_t>(CC::split.ch[c].q_u));
+        k.q_v[c] = _mm_set1_epi16(static_cast<int16_t>(CC::split.ch[c].q_v));
+        k.r_u[c] = _mm_set1_epi16(static_cast<int16_t>(CC::split.ch[c].r_u));
+        k.r_v[c] = _mm_set1_epi16(static_cast<int16_t>(CC::split.ch[c].r_v));
+    }
+}
+
+// 8组UV -> 16个像素的 add/rest 项，[通道][lo/hi]
+NV12_TARGET_SSE41
+static inline void ChromaTerms_SSE41(const uint8_t* uv_ptr, const Coeffs_SSE41& k, __m128i add[3][2], __m128i rest[3][2]) {
+    const __m128i k128 = _mm_set1_epi16(128);
+    const __m128i kLowByte = _mm_set1_epi16(0x00FF);
+
+    __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv_ptr));
+    __m128i D = _mm_sub_epi16(_mm_and_si128(uv, kLowByte), k128);
+    __m128i E = _mm_sub_epi16(_mm_srli_epi16(uv, 8), k128);
+
+    for (int c = 0; c < 3; c++) {
+        __m128i a = _mm_add_epi16(_mm_mullo_epi16(D, k.q_u[c]), _mm_mullo_epi16(E, k.q_v[c]));
+        __m128i r = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(D, k.r_u[c]), _mm_mullo_epi16(E, k.r_v[c])), k128);
+        // unpacklo/hi_epi16(v, v) 把每个色度项复制给相邻的两个像素
+        add[c][0] = _mm_unpacklo_epi16(a, a);
+        add[c][1] = _mm_unpackhi_epi16(a, a);
+        rest[c][0] = _mm_unpacklo_epi16(r, r);
+        rest[c][1] = _mm_unpackhi_epi16(r, r);
+    }
+}
+
+// RGB565: 三个通道的16位值 (0~255) 拼成16位像素
+NV12_TARGET_SSE41
+static inline __m128i PackRGB565_SSE41(__m128i r, __m128i g, __m128i b) {
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(r, _mm_set1_epi16(0xF8)), 8);
+    __m128i mid = _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0xFC)), 3);
+    return _mm_or_si128(_mm_or_si128(hi, mid), _mm_srli_epi16(b, 3));
+}
+
+// 16个像素的R/G/B (按像素顺序的字节) 按输出格式写出
+template <NV12PixelFormat F>
+NV12_TARGET_SSE41
+static inline void StorePixels_SSE41(const __m128i rgb[3], const __m128i shuf[3][3], uint8_t* dst, ptrdiff_t plane_stride) {
+    const __m128i ch[4] = { rgb[0], rgb[1], rgb[2], _mm_set1_epi8(-1) };
+    if constexpr (NV12PixelStride(F) == 3) {
+        for (int chunk = 0; chunk < 3; chunk++) {
+            __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(ch[NV12ChannelAt(F, 0)], shuf[chunk][0]),
+                                                    _mm_shuffle_epi8(ch[NV12ChannelAt(F, 1)], shuf[chunk][1])),
+                                       _mm_shuffle_epi8(ch[NV12ChannelAt(F, 2)], shuf[chunk][2]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + chunk * 16), out);
+        }
+    } else if constexpr (NV12PixelStride(F) == 4) {
+        __m128i c01_lo = _mm_unpacklo_epi8(ch[NV12ChannelAt(F, 0)], ch[NV12ChannelAt(F, 1)]);
+        __m128i c01_hi = _mm_unpackhi_epi8(ch[NV12ChannelAt(F, 0)], ch[NV12ChannelAt(F, 1)]);
+        __m128i c23_lo = _mm_unpacklo_epi8(ch[NV12ChannelAt(F, 2)], ch[NV12ChannelAt(F, 3)]);
+        __m128i c23_hi = _mm_unpackhi_epi8(ch[NV12ChannelAt(F, 2)], ch[NV12ChannelAt(F, 3)]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0), _mm_unpacklo_epi16(c01_lo, c23_lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(c01_lo, c23_lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_unpacklo_epi16(c01_hi, c23_hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_unpackhi_epi16(c01_hi, c23_hi));
+    } else if constexpr (F == NV12PixelFormat::RGB565) {
+        const __m128i zero = _mm_setzero_si128();
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0),
+                         PackRGB565_SSE41(_mm_cvtepu8_epi16(rgb[0]), _mm_cvtepu8_epi16(rgb[1]), _mm_cvtepu8_epi16(rgb[2])));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16),
+                         PackRGB565_SSE41(_mm_unpackhi_epi8(rgb[0], zero), _mm_unpackhi_epi8(rgb[1], zero),
+                                          _mm_unpackhi_epi8(rgb[2], zero)));
+    } else {
+        for (int c = 0; c < 3; c++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + c * plane_stride), rgb[c]);
+        }
+    }
+}
+
+// 16个Y像素 + 色度项 -> 16个输出像素
+template <NV12PixelFormat F>
+NV12_TARGET_SSE41
+static inline void LumaToPixels_SSE41(const uint8_t* y_ptr, const Coeffs_SSE41& k, const __m128i add[3][2],
+                                      const __m128i rest[3][2], const __m128i shuf[3][3], uint8_t* dst,
+                                      ptrdiff_t plane_stride) {
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y_ptr));
+    __m128i C[2] = {
+        _mm_sub_epi16(_mm_cvtepu8_epi16(y), k.y_offset),
+        _mm_sub_epi16(_mm_unpackhi_epi8(y, _mm_setzero_si128()), k.y_offset),
+    };
+    __m128i Cr[2] = { _mm_mullo_epi16(C[0], k.r_y), _mm_mullo_epi16(C[1], k.r_y) };
+
+    __m128i rgb[3];
+    for (int c = 0; c < 3; c++) {
+        __m128i v[2];
+        for (int h = 0; h < 2; h++) {
+            v[h] = _mm_add_epi16(_mm_add_epi16(C[h], add[c][h]), _mm_srai_epi16(_mm_add_epi16(Cr[h], rest[c][h]), 8));
+        }
+        rgb[c] = _mm_packus_epi16(v[0], v[1]);
+    }
+    StorePixels_SSE41<F>(rgb, shuf, dst, plane_stride);
+}
+
+template <NV12PixelFormat F, NV12Matrix M, NV12Range R>
+NV12_TARGET_SSE41
+static void NV12ToRGBRowPair_SSE41(const uint8_t* y_row0, const uint8_t* y_row1, const uint8_t* uv_row,
+                                   uint8_t* rgb_row0, uint8_t* rgb_row1, int width, ptrdiff_t plane_stride,
+                                   const NV12ColorParams& p) {
+    constexpr int kStride = NV12PixelStride(F);
+    Coeffs_SSE41 k;
+    LoadCoeffs_SSE41<M, R>(k);
+    __m128i shuf[3][3];
+    for (int chunk = 0; chunk < 3; chunk++) {
+        for (int ch = 0; ch < 3; ch++) {
+            shuf[chunk][ch] = _mm_load_si128(reinterpret_cast<const __m128i*>(kShuffleRGB24[chunk][ch]));
+        }
+    }
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i add[3][2], rest[3][2];
+        ChromaTerms_SSE41(uv_row + x, k, add, rest);
+        LumaToPixels_SSE41<F>(y_row0 + x, k, add, rest, shuf, rgb_row0 + x * kStride, plane_stride);
+        LumaToPixels_SSE41<F>(y_row1 + x, k, add, rest, shuf, rgb_row1 + x * kStride, plane_stride);
+    }
+
+    // 行尾不足16个像素的部分交给标量版本 (x为偶数，UV对齐不变)
+    if (x < width) {
+        NV12ToRGBRowPair_C<F, M, R>(y_row0 + x, y_row1 + x, uv_row + x, rgb_row0 + x * kStride, rgb_row1 + x * kStride,
+                                    width - x, plane_stride, p);
+    }
+}
+
+// ---- AVX2: 每次处理2x32个Y像素和16组UV ----
+
+struct Coeffs_AVX2 {
+    __m256i y_offset, r_y;
+    __m256i q_u[3], q_v[3], r_u[3], r_v[3];
+};
+
+template <NV12Matrix M, NV12Range R>
+NV12_TARGET_AVX2
+static inline void LoadCoeffs_AVX2(Coeffs_AVX2& k) {
+    typedef NV12ColorConstants<M, R> CC;
+    k.y_offset = _mm256_set1_epi16(static_cast<int16_t>(CC::k.y_offset));
+    k.r_y = _mm256_set1_epi16(static_cast<int16_t>(CC::split.r_y));
+    for (int c = 0; c < 3; c++) {
+        k.q_u[c] = _mm256_set1_epi16(static_cast<int16_t>(CC::split.ch[c].q_u));
+        k.q_v[c] = _mm256_set1_epi16(static_cast<int16_t>(CC::split.ch[c].q_v));
+        k.r_u[c] = _mm256_set1_epi16(static_cast<int16_t>(CC::split.ch[c].r_u));
+        k.r_v[c] = _mm256_set1_epi16(static_cast<int16_t>(CC::split.ch[c].r_v));
+    }
+}
+
+// 16位结果饱和打包成8位，lane0为像素0-15，lane1为像素16-31
+NV12_TARGET_AVX2
+static inline __m256i Pack_AVX2(__m256i lo, __m256i hi) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+}
+
+// 16个16位色度项复制成32个像素，并按像素顺序排好
+NV12_TARGET_AVX2
+static inline void DupChroma_AVX2(__m256i v, __m256i out[2]) {
+    __m256i lo = _mm256_unpacklo_epi16(v, v);   // 像素 0-7 | 16-23
+    __m256i hi = _mm256_unpackhi_epi16(v, v);   // 像素 8-15 | 24-31
+    out[0] = _mm256_permute2x128_si256(lo, hi, 0x20);
+    out[1] = _mm256_permute2x128_si256(lo, hi, 0x31);
+}
+
+// 16组UV -> 32个像素的 add/rest 项，[通道][lo/hi]
+NV12_TARGET_AVX2
+static inline void ChromaTerms_AVX2(const uint8_t* uv_ptr, const Coeffs_AVX2& k, __m256i add[3][2], __m256i rest[3][2]) {
+    const __m256i k128 = _mm256_set1_epi16(128);
+    const __m256i kLowByte = _mm256_set1_epi16(0x00FF);
+
+    __m256i uv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv_ptr));
+    __m256i D = _mm256_sub_epi16(_mm256_and_si256(uv, kLowByte), k128);
+    __m256i E = _mm256_sub_epi16(_mm256_srli_epi16(uv, 8), k128);
+
+    for (int c = 0; c < 3; c++) {
+        __m256i a = _mm256_add_epi16(_mm256_mullo_epi16(D, k.q_u[c]), _mm256_mullo_epi16(E, k.q_v[c]));
+        __m256i r = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(D, k.r_u[c]), _mm256_mullo_epi16(E, k.r_v[c])), k128);
+        DupChroma_AVX2(a, add[c]);
+        DupChroma_AVX2(r, rest[c]);
+    }
+}
+
+NV12_TARGET_AVX2
+static inline __m256i PackRGB565_AVX2(__m256i r, __m256i g, __m256i b) {
+    __m256i hi = _mm256_slli_epi16(_mm256_and_si256(r, _mm256_set1_epi16(0xF8)), 8);
+    __m256i mid = _mm256_slli_epi16(_mm256_and_si256(g, _mm256_set1_epi16(0xFC)), 3);
+    return _mm256_or_si256(_mm256_or_si256(hi, mid), _mm256_srli_epi16(b, 3));
+}
+
+// 32个像素的R/G/B (按像素顺序的字节) 按输出格式写出
+template <NV12PixelFormat F>
+NV12_TARGET_AVX2
+static inline void StorePixels_AVX2(const __m256i rgb[3], const __m256i shuf[3][3], uint8_t* dst, ptrdiff_t plane_stride) {
+    const __m256i ch[4] = { rgb[0], rgb[1], rgb[2], _mm256_set1_epi8(-1) };
+    if constexpr (NV12PixelStride(F) == 3) {
+        // 每个lane内交织出48字节，再把两个lane的输出块按顺序拼接
+        __m256i out[3];
+        for (int chunk = 0; chunk < 3; chunk++) {
+            out[chunk] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(ch[NV12ChannelAt(F, 0)], shuf[chunk][0]),
+                                                         _mm256_shuffle_epi8(ch[NV12ChannelAt(F, 1)], shuf[chunk][1])),
+                                         _mm256_shuffle_epi8(ch[NV12ChannelAt(F, 2)], shuf[chunk][2]));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 0), _mm256_permute2x128_si256(out[0], out[1], 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_permute2x128_si256(out[2], out[0], 0x30));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 64), _mm256_permute2x128_si256(out[1], out[2], 0x31));
+    } else if constexpr (NV12PixelStride(F) == 4) {
+        // lane内unpack后 a: 像素0-3|16-19, b: 4-7|20-23, c: 8-11|24-27, d: 12-15|28-31
+        __m256i c01_lo = _mm256_unpacklo_epi8(ch[NV12ChannelAt(F, 0)], ch[NV12ChannelAt(F, 1)]);
+        __m256i c01_hi = _mm256_unpackhi_epi8(ch[NV12ChannelAt(F, 0)], ch[NV12ChannelAt(F, 1)]);
+        __m256i c23_lo = _mm256_unpacklo_epi8(ch[NV12ChannelAt(F, 2)], ch[NV12ChannelAt(F, 3)]);
+        __m256i c23_hi = _mm256_unpackhi_epi8(ch[NV12ChannelAt(F, 2)], ch[NV12ChannelAt(F, 3)]);
+        __m256i a = _mm256_unpacklo_epi16(c01_lo, c23_lo);
+        __m256i b = _mm256_unpackhi_epi16(c01_lo, c23_lo);
+        __m256i c = _mm256_unpacklo_epi16(c01_hi, c23_hi);
+        __m256i d = _mm256_unpackhi_epi16(c01_hi, c23_hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 0), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_permute2x128_si256(c, d, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 64), _mm256_permute2x128_si256(a, b, 0x31));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 96), _mm256_permute2x128_si256(c, d, 0x31));
+    } else if constexpr (F == NV12PixelFormat::RGB565) {
+        for (int h = 0; h < 2; h++) {
+            __m256i c16[3];
+            for (int c = 0; c < 3; c++) {
+                c16[c] = _mm256_cvtepu8_epi16(h ? _mm256_extracti128_si256(rgb[c], 1) : _mm256_castsi256_si128(rgb[c]));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + h * 32), PackRGB565_AVX2(c16[0], c16[1], c16[2]));
+        }
+    } else {
+        for (int c = 0; c < 3; c++) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + c * plane_stride), rgb[c]);
+        }
+    }
+}
+
+// 32个Y像素 + 色度项 -> 32个输出像素
+template <NV12PixelFormat F>
+NV12_TARGET_AVX2
+static inline void LumaToPixels_AVX2(const uint8_t* y_ptr, const Coeffs_AVX2& k, const __m256i add[3][2],
+                                     const __m256i rest[3][2], const __m256i shuf[3][3], uint8_t* dst,
+                                     ptrdiff_t plane_stride) {
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y_ptr));
+    __m256i C[2] = {
+        _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(y)), k.y_offset),
+        _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(y, 1)), k.y_offset),
+    };
+    __m256i Cr[2] = { _mm256_mullo_epi16(C[0], k.r_y), _mm256_mullo_epi16(C[1], k.r_y) };
+
+    __m256i rgb[3];
+    for (int c = 0; c < 3; c++) {
+        __m256i v[2];
+        for (int h = 0; h < 2; h++) {
+            v[h] = _mm256_add_epi16(_mm256_add_epi16(C[h], add[c][h]), _mm256_srai_epi16(_mm256_add_epi16(Cr[h], rest[c][h]), 8));
+        }
+        rgb[c] = Pack_AVX2(v[0], v[1]);
+    }
+    StorePixels_AVX2<F>(rgb, shuf, dst, plane_stride);
+}
+
+template <NV12PixelFormat F, NV12Matrix M, NV12Range R>
+NV12_TARGET_AVX2
+static void NV12ToRGBRowPair_AVX2(const uint8_t* y_row0, const uint8_t* y_row1, const uint8_t* uv_row,
+                                  uint8_t* rgb_row0, uint8_t* rgb_row1, int width, ptrdiff_t plane_stride,
+                                  const NV12ColorParams& p) {
+    constexpr int kStride = NV12PixelStride(F);
+    Coeffs_AVX2 k;
+    LoadCoeffs_AVX2<M, R>(k);
+    __m256i shuf[3][3];
+    for (int chunk = 0; chunk < 3; chunk++) {
+        for (int ch = 0; ch < 3; ch++) {
+            shuf[chunk][ch] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShuffleRGB24[chunk][ch])));
+        }
+    }
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i add[3][2], rest[3][2];
+        ChromaTerms_AVX2(uv_row + x, k, add, rest);
+        LumaToPixels_AVX2<F>(y_row0 + x, k, add, rest, shuf, rgb_row0 + x * kStride, plane_stride);
+        LumaToPixels_AVX2<F>(y_row1 + x, k, add, rest, shuf, rgb_row1 + x * kStride, plane_stride);
+    }
+
+    // 行尾不足32个像素的部分交给标量版本 (x为偶数，UV对齐不变)
+    if (x < width) {
+        NV12ToRGBRowPair_C<F, M, R>(y_row0 + x, y_row1 + x, uv_row + x, rgb_row0 + x * kStride, rgb_row1 + x * kStride,
+                                    width - x, plane_stride, p);
+    }
+}
+
+// ---- AVX-512BW: 每次处理2x64个Y像素和32组UV ----
+// 行尾用mask寄存器做带掩码的读写，不需要标量收尾 (如宽度1918)
+
+struct Coeffs_AVX512 {
+    __m512i y_offset, r_y;
+    __m512i q_u[3], q_v[3], r_u[3], r_v[3];
+};
+
+template <NV12Matrix M, NV12Range R>
+NV12_TARGET_AVX512BW
+static inline void LoadCoeffs_AVX512(Coeffs_AVX512& k) {
+    typedef NV12ColorConstants<M, R> CC;
+    k.y_offset = _mm512_set1_epi16(static_cast<int16_t>(CC::k.y_offset));
+    k.r_y = _mm512_set1_epi16(static_cast<int16_t>(CC::split.r_y));
+    for (int c = 0; c < 3; c++) {
+        k.q_u[c] = _mm512_set1_epi16(static_cast<int16_t>(CC::split.ch[c].q_u));
+        k.q_v[c] = _mm512_set1_epi16(static_cast<int16_t>(CC::split.ch[c].q_v));
+        k.r_u[c] = _mm512_set1_epi16(static_cast<int16_t>(CC::split.ch[c].r_u));
+        k.r_v[c] = _mm512_set1_epi16(static_cast<int16_t>(CC::split.ch[c].r_v));
+    }
+}
+
+// 取低count个字节的掩码，count可以超过64
+static inline __mmask64 ByteMask64(int count) {
+    return count >= 64 ? ~__mmask64(0) : (__mmask64(1) << count) - 1;
+}
+
+// 16位结果饱和打包成8位，lane k 为像素 16k ~ 16k+15
+NV12_TARGET_AVX512BW
+static inline __m512i Pack_AVX512(__m512i lo, __m512i hi) {
+    const __m512i kIdx = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    return _mm512_permutexvar_epi64(kIdx, _mm512_packus_epi16(lo, hi));
+}
+
+// 32个16位色度项复制成64个像素，并按像素顺序排好
+NV12_TARGET_AVX512BW
+static inline void DupChroma_AVX512(__m512i v, __m512i out[2]) {
+    const __m512i kIdxLo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+    const __m512i kIdxHi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+    __m512i lo = _mm512_unpacklo_epi16(v, v);   // 像素 0-7 | 16-23 | 32-39 | 48-55
+    __m512i hi = _mm512_unpackhi_epi16(v, v);   // 像素 8-15 | 24-31 | 40-47 | 56-63
+    out[0] = _mm512_permutex2var_epi64(lo, kIdxLo, hi);
+    out[1] = _mm512_permutex2var_epi64(lo, kIdxHi, hi);
+}
+
+// 32组UV -> 64个像素的 add/rest 项，[通道][lo/hi]
+// 与标量版本读取相同的UV字节: 奇数宽度时最后一个像素仍然读取一整组UV
+NV12_TARGET_AVX512BW
+static inline void ChromaTerms_AVX512(const uint8_t* uv_ptr, int n, const Coeffs_AVX512& k,
+                                      __m512i add[3][2], __m512i rest[3][2]) {
+    const __m512i k128 = _mm512_set1_epi16(128);
+    const __m512i kLowByte = _mm512_set1_epi16(0x00FF);
+
+    __m512i uv = _mm512_maskz_loadu_epi8(ByteMask64((n + 1) & ~1), uv_ptr);
+    __m512i D = _mm512_sub_epi16(_mm512_and_si512(uv, kLowByte), k128);
+    __m512i E = _mm512_sub_epi16(_mm512_srli_epi16(uv, 8), k128);
+
+    for (int c = 0; c < 3; c++) {
+        __m512i a = _mm512_add_epi16(_mm512_mullo_epi16(D, k.q_u[c]), _mm512_mullo_epi16(E, k.q_v[c]));
+        __m512i r = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(D, k.r_u[c]), _mm512_mullo_epi16(E, k.r_v[c])), k128);
+        DupChroma_AVX512(a, add[c]);
+        DupChroma_AVX512(r, rest[c]);
+    }
+}
+
+NV12_TARGET_AVX512BW
+static inline __m512i PackRGB565_AVX512(__m512i r, __m512i g, __m512i b) {
+    __m512i hi = _mm512_slli_epi16(_mm512_and_si512(r, _mm512_set1_epi16(0xF8)), 8);
+    __m512i mid = _mm512_slli_epi16(_mm512_and_si512(g, _mm512_set1_epi16(0xFC)), 3);
+    return _mm512_or_si512(_mm512_or_si512(hi, mid), _mm512_srli_epi16(b, 3));
+}
+
+// n (<=64) 个像素的R/G/B (按像素顺序的字节) 按输出格式写出，超出n的部分不写
+template <NV12PixelFormat F>
+NV12_TARGET_AVX512BW
+static inline void StorePixels_AVX512(const __m512i rgb[3], int n, const __m512i shuf[3][3], uint8_t* dst,
+                                      ptrdiff_t plane_stride) {
+    const __m512i ch[4] = { rgb[0], rgb[1], rgb[2], _mm512_set1_epi8(-1) };
+    int bytes = n * NV12PixelStride(F);
+    if constexpr (NV12PixelStride(F) == 3) {
+        // 4个lane各自交织出48字节后，12个16字节块的重排索引 (qword粒度)
+        const __m512i kOut0 = _mm512_setr_epi64(0, 1, 8, 9, 0, 0, 2, 3);
+        const __m512i kOut0c = _mm512_setr_epi64(0, 0, 0, 0, 0, 1, 0, 0);
+        const __m512i kOut1 = _mm512_setr_epi64(10, 11, 0, 0, 4, 5, 12, 13);
+        const __m512i kOut1c = _mm512_setr_epi64(0, 0, 2, 3, 0, 0, 0, 0);
+        const __m512i kOut2 = _mm512_setr_epi64(0, 0, 6, 7, 14, 15, 0, 0);
+        const __m512i kOut2c = _mm512_setr_epi64(4, 5, 0, 0, 0, 0, 6, 7);
+
+        __m512i out[3];
+        for (int chunk = 0; chunk < 3; chunk++) {
+            out[chunk] = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(ch[NV12ChannelAt(F, 0)], shuf[chunk][0]),
+                                                         _mm512_shuffle_epi8(ch[NV12ChannelAt(F, 1)], shuf[chunk][1])),
+                                         _mm512_shuffle_epi8(ch[NV12ChannelAt(F, 2)], shuf[chunk][2]));
+        }
+        __m512i v0 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(out[0], kOut0, out[1]), 0x30, kOut0c, out[2]);
+        __m512i v1 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(out[0], kOut1, out[1]), 0x0C, kOut1c, out[2]);
+        __m512i v2 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(out[0], kOut2, out[1]), 0xC3, kOut2c, out[2]);
+
+        _mm512_mask_storeu_epi8(dst + 0, ByteMask64(bytes), v0);
+        _mm512_mask_storeu_epi8(dst + 64, ByteMask64(std::max(bytes - 64, 0)), v1);
+        _mm512_mask_storeu_epi8(dst + 128, ByteMask64(std::max(bytes - 128, 0)), v2);
+    } else if constexpr (NV12PixelStride(F) == 4) {
+        // lane内unpack后 a/b/c/d 的lane k 分别为像素 16k+0~3 / 4~7 / 8~11 / 12~15，
+        // 先两两合并成 (a,b) (c,d) 的8像素块，再拼成按像素顺序的4个64字节输出
+        const __m512i kIdxLo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+        const __m512i kIdxHi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+        const __m512i kJoinLo = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+        const __m512i kJoinHi = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+        __m512i c01_lo = _mm512_unpacklo_epi8(ch[NV12ChannelAt(F, 0)], ch[NV12ChannelAt(F, 1)]);
+        __m512i c01_hi = _mm512_unpackhi_epi8(ch[NV12ChannelAt(F, 0)], ch[NV12ChannelAt(F, 1)]);
+        __m512i c23_lo = _mm512_unpacklo_epi8(ch[NV12ChannelAt(F, 2)], ch[NV12ChannelAt(F, 3)]);
+        __m512i c23_hi = _mm512_unpackhi_epi8(ch[NV12ChannelAt(F, 2)], ch[NV12ChannelAt(F, 3)]);
+        __m512i a = _mm512_unpacklo_epi16(c01_lo, c23_lo);
+        __m512i b = _mm512_unpackhi_epi16(c01_lo, c23_lo);
+        __m512i c = _mm512_unpacklo_epi16(c01_hi, c23_hi);
+        __m512i d = _mm512_unpackhi_epi16(c01_hi, c23_hi);
+        __m512i ab_lo = _mm512_permutex2var_epi64(a, kIdxLo, b);   // 像素 0-7 | 16-23
+        __m512i ab_hi = _mm512_permutex2var_epi64(a, kIdxHi, b);   // 像素 32-39 | 48-55
+        __m512i cd_lo = _mm512_permutex2var_epi64(c, kIdxLo, d);   // 像素 8-15 | 24-31
+        __m512i cd_hi = _mm512_permutex2var_epi64(c, kIdxHi, d);   // 像素 40-47 | 56-63
+        __m512i out[4] = {
+            _mm512_permutex2var_epi64(ab_lo, kJoinLo, cd_lo),
+            _mm512_permutex2var_epi64(ab_lo, kJoinHi, cd_lo),
+            _mm512_permutex2var_epi64(ab_hi, kJoinLo, cd_hi),
+            _mm512_permutex2var_epi64(ab_hi, kJoinHi, cd_hi),
+        };
+        for (int i = 0; i < 4; i++) {
+            _mm512_mask_storeu_epi8(dst + i * 64, ByteMask64(std::max(bytes - i * 64, 0)), out[i]);
+        }
+    } else if constexpr (F == NV12PixelFormat::RGB565) {
+        for (int h = 0; h < 2; h++) {
+            __m512i c16[3];
+            for (int c = 0; c < 3; c++) {
+                c16[c] = _mm512_cvtepu8_epi16(h ? _mm512_extracti64x4_epi64(rgb[c], 1) : _mm512_castsi512_si256(rgb[c]));
+            }
+            _mm512_mask_storeu_epi8(dst + h * 64, ByteMask64(std::max(bytes - h * 64, 0)),
+                                    PackRGB565_AVX512(c16[0], c16[1], c16[2]));
+        }
+    } else {
+        for (int c = 0; c < 3; c++) {
+            _mm512_mask_storeu_epi8(dst + c * plane_stride, ByteMask64(n), rgb[c]);
+        }
+    }
+}
+
+// n (<=64) 个Y像素 + 色度项 -> n个输出像素
+template <NV12PixelFormat F>
+NV12_TARGET_AVX512BW
+static inline void LumaToPixels_AVX512(const uint8_t* y_ptr, int n, const Coeffs_AVX512& k, const __m512i add[3][2],
+                                       const __m512i rest[3][2], const __m512i shuf[3][3], uint8_t* dst,
+                                       ptrdiff_t plane_stride) {
+    __m512i y = _mm512_maskz_loadu_epi8(ByteMask64(n), y_ptr);
+    __m512i C[2] = {
+        _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm512_castsi512_si256(y)), k.y_offset),
+        _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(y, 1)), k.y_offset),
+    };
+    __m512i Cr[2] = { _mm512_mullo_epi16(C[0], k.r_y), _mm512_mullo_epi16(C[1], k.r_y) };
+
+    __m512i rgb[3];
+    for (int c = 0; c < 3; c++) {
+        __m512i v[2];
+        for (int h = 0; h < 2; h++) {
+            v[h] = _mm512_add_epi16(_mm512_add_epi16(C[h], add[c][h]), _mm512_srai_epi16(_mm512_add_epi16(Cr[h], rest[c][h]), 8));
+        }
+        rgb[c] = Pack_AVX512(v[0], v[1]);
+    }
+    StorePixels_AVX512<F>(rgb, n, shuf, dst, plane_stride);
+}
+
+template <NV12PixelFormat F, NV12Matrix M, NV12Range R>
+NV12_TARGET_AVX512BW
+static void NV12ToRGBRowPair_AVX512BW(const uint8_t* y_row0, const uint8_t* y_row1, const uint8_t* uv_row,
+                                      uint8_t* rgb_row0, uint8_t* rgb_row1, int width, ptrdiff_t plane_stride,
+                                      const NV12ColorParams&) {
+    constexpr int kStride = NV12PixelStride(F);
+    Coeffs_AVX512 k;
+    LoadCoeffs_AVX512<M, R>(k);
+    __m512i shuf[3][3];
+    for (int chunk = 0; chunk < 3; chunk++) {
+        for (int ch = 0; ch < 3; ch++) {
+            shuf[chunk][ch] = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShuffleRGB24[chunk][ch])));
+        }
+    }
+
+    for (int x = 0; x < width; x += 64) {
+        int n = std::min(width - x, 64);
+        __m512i add[3][2], rest[3][2];
+        ChromaTerms_AVX512(uv_row + x, n, k, add, rest);
+        LumaToPixels_AVX512<F>(y_row0 + x, n, k, add, rest, shuf, rgb_row0 + x * kStride, plane_stride);
+        LumaToPixels_AVX512<F>(y_row1 + x, n, k, add, rest, shuf, rgb_row1 + x * kStride, plane_stride);
+    }
+}
+
+static bool CpuHasSSE41() { return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1"); }
+static bool CpuHasAVX2() { return __builtin_cpu_supports("avx2"); }
+static bool CpuHasAVX512BW() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"); }
+#endif
+
+static bool CpuAlways() { return true; }
+
+// 可用的转换内核，按优先级排列，启动时选择第一个CPU支持的
+// row_pair 按 [输出格式][matrix][range] 存放每种组合的实例
+struct NV12Kernel {
+    const char* name;
+    bool (*supported)();
+    NV12RowPairFunc row_pair[kNV12PixelFormatCount][3][2];
+};
+
+#define NV12_COLOR_SPACE_VARIANTS(fn, F)                                                               \
+    {                                                                                                  \
+        { fn<F, NV12Matrix::BT601, NV12Range::Limited>, fn<F, NV12Matrix::BT601, NV12Range::Full> },   \
+        { fn<F, NV12Matrix::BT709, NV12Range::Limited>, fn<F, NV12Matrix::BT709, NV12Range::Full> },   \
+        { fn<F, NV12Matrix::BT2020, NV12Range::Limited>, fn<F, NV12Matrix::BT2020, NV12Range::Full> }, \
+    }
+
+// 系数不在编译期确定的内核 (查表)，所有颜色空间共用一个实例
+#define NV12_ANY_COLOR_SPACE(fn, F) \
+    { { fn<F>, fn<F> }, { fn<F>, fn<F> }, { fn<F>, fn<F> } }
+
+#define NV12_FORMAT_VARIANTS(VARIANTS, fn)          \
+    {                                               \
+        VARIANTS(fn, NV12PixelFormat::RGB24),       \
+        VARIANTS(fn, NV12PixelFormat::BGR24),       \
+        VARIANTS(fn, NV12PixelFormat::RGBA32),      \
+        VARIANTS(fn, NV12PixelFormat::BGRA32),      \
+        VARIANTS(fn, NV12PixelFormat::ARGB32),      \
+        VARIANTS(fn, NV12PixelFormat::RGB565),      \
+        VARIANTS(fn, NV12PixelFormat::RGBPlanar),   \
+    }
+
+static const NV12Kernel kNV12Kernels[] = {
+#ifdef NV12_HAVE_X86
+    { "avx512bw", CpuHasAVX512BW, NV12_FORMAT_VARIANTS(NV12_COLOR_SPACE_VARIANTS, NV12ToRGBRowPair_AVX512BW) },
+    { "avx2", CpuHasAVX2, NV12_FORMAT_VARIANTS(NV12_COLOR_SPACE_VARIANTS, NV12ToRGBRowPair_AVX2) },
+    { "sse4.1", CpuHasSSE41, NV12_FORMAT_VARIANTS(NV12_COLOR_SPACE_VARIANTS, NV12ToRGBRowPair_SSE41) },
+#endif
+    { "c", CpuAlways, NV12_FORMAT_VARIANTS(NV12_COLOR_SPACE_VARIANTS, NV12ToRGBRowPair_C) },
+    // 排在 "c" 之后，不会被自动选中，只能用 NV12_KERNEL=lut 指定
+    { "lut", CpuAlways, NV12_FORMAT_VARIANTS(NV12_ANY_COLOR_SPACE, NV12ToRGBRowPair_LUT) },
+};
+
+// 环境变量 NV12_KERNEL=<name> 可以强制使用指定的内核 (例如对比测试或基准测试)
+static const NV12Kernel& SelectNV12Kernel() {
+    const char* forced = getenv("NV12_KERNEL");
+    if (forced) {
+        for (const NV12Kernel& k : kNV12Kernels) {
+            if (strcmp(k.name, forced) == 0 && k.supported()) return k;
+        }
+        std::cerr << "NV12_KERNEL=" << forced << " is not available, using auto selection\n";
+    }
+    for (const NV12Kernel& k : kNV12Kernels) {
+        if (k.supported()) return k;
+    }
+    return kNV12Kernels[sizeof(kNV12Kernels) / sizeof(kNV12Kernels[0]) - 1];
+}
+
+static const NV12Kernel& g_nv12_kernel = SelectNV12Kernel();
+
+// 转换第 [j_begin, j_end) 行，j_begin 必须为偶数，这样每组UV行只属于一个区间
+// 平面格式的 G/B 平面依次位于 R 平面之后 dst_pitch*height 字节处
+// kernel 默认为启动时选择的内核，基准测试可以指定其他内核
+static void NV12ToRGBRows(const uint8_t* y_plane, int y_pitch, const uint8_t* uv_plane, int uv_pitch,
+                          int width, int height, int j_begin, int j_end, uint8_t* dst, int dst_pitch,
+                          NV12ColorSpace color_space, NV12PixelFormat format,
+                          const NV12Kernel& kernel = g_nv12_kernel) {
+    NV12RowPairFunc row_pair = kernel.row_pair[static_cast<int>(format)][static_cast<int>(color_space.matrix)]
+                                              [static_cast<int>(color_space.range)];
+    const NV12ColorParams& p = GetNV12ColorParams(color_space);
+    ptrdiff_t plane_stride = static_cast<ptrdiff_t>(dst_pitch) * height;
+    // 每次处理共用一行UV的两行Y
+    for (int j = j_begin; j < j_end; j += 2) {
+        int j1 = std::min(j + 1, height - 1);
+        row_pair(y_plane + static_cast<ptrdiff_t>(j) * y_pitch, y_plane + static_cast<ptrdiff_t>(j1) * y_pitch,
+                 uv_plane + static_cast<ptrdiff_t>(j / 2) * uv_pitch,
+                 dst + static_cast<ptrdiff_t>(j) * dst_pitch, dst + static_cast<ptrdiff_t>(j1) * dst_pitch,
+                 width, plane_stride, p);
+    }
+}
+
+// ---- 调用者持有的缓冲区 ----
+//
+// 60fps的流水线里每帧都 resize 一个新的 std::vector 会让每帧都重新分配并缺页 (1080p RGB24 约6MB)。
+// 下面的类型让调用者持有输出缓冲区，跨帧反复使用。
+
+// 输出缓冲区 (C++17 没有 std::span)
+struct NV12ByteSpan {
+    uint8_t* data;
+    size_t size;
+};
+
+// 紧凑排列 (行距等于宽度) 时一帧NV12输入和输出的字节数
+inline size_t NV12FrameSize(int width, int height) {
+    return static_cast<size_t>(width) * height * 3 / 2;
+}
+
+inline size_t NV12OutputFrameSize(int width, int height, NV12PixelFormat format) {
+    return static_cast<size_t>(width) * height * NV12BytesPerPixel(format);
+}
+
+// 64字节 (缓存行) 对齐的缓冲区，只有需要更大容量时才重新分配，缩小时保留原来的内存
+// 也可以指定更大的对齐 (如 O_DIRECT 需要的页对齐)
+class NV12AlignedBuffer {
+public:
+    static const size_t kAlignment = 64;
+
+    NV12AlignedBuffer() = default;
+    explicit NV12AlignedBuffer(size_t size, size_t alignment = kAlignment) : alignment_(alignment) { Resize(size); }
+    ~NV12AlignedBuffer() { free(data_); }
+
+    NV12AlignedBuffer(const NV12AlignedBuffer&) = delete;
+    NV12AlignedBuffer& operator=(const NV12AlignedBuffer&) = delete;
+
+    // 不保留原有内容
+    void Resize(size_t size) {
+        if (size > capacity_) {
+            free(data_);
+            capacity_ = (size + alignment_ - 1) / alignment_ * alignment_;
+            data_ = static_cast<uint8_t*>(aligned_alloc(alignment_, capacity_));
+            if (!data_) throw std::bad_alloc();
+            // 分配时就把页面全部触碰一遍，之后每帧使用都不会再缺页
+            memset(data_, 0, capacity_);
+        }
+        size_ = size;
+    }
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    NV12ByteSpan span() { return NV12ByteSpan{ data_, size_ }; }
+
+private:
+    size_t alignment_ = kAlignment;
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+// 帧缓冲池: 缓冲区用完后放回池中，下一帧直接复用，稳定运行后不再分配内存
+// 可以在多个线程之间传递缓冲区 (Acquire/Release 是线程安全的)
+class NV12FramePool {
+public:
+    explicit NV12FramePool(size_t frame_size) : frame_size_(frame_size) {}
+
+    // 取一个大小为 frame_size 的缓冲区，池为空时才分配新的
+    std::unique_ptr<NV12AlignedBuffer> Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                std::unique_ptr<NV12AlignedBuffer> buf = std::move(free_.back());
+                free_.pop_back();
+                return buf;
+            }
+        }
+        return std::unique_ptr<NV12AlignedBuffer>(new NV12AlignedBuffer(frame_size_));
+    }
+
+    void Release(std::unique_ptr<NV12AlignedBuffer> buf) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(buf));
+    }
+
+    size_t frame_size() const { return frame_size_; }
+
+private:
+    size_t frame_size_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<NV12AlignedBuffer>> free_;
+};
+
+// 带行距 (pitch) 的版本: Y平面和UV平面分开给出，每行末尾可以有填充，
+// 可以直接转换解码器或GBM/dma-buf的表面 (stride0、offset1、stride1)，不需要先拷贝成紧凑的NV12
+// 输入:
+//   y_plane, y_pitch: Y平面和相邻两行的字节数 (>= width)
+//   uv_plane, uv_pitch: UV交织平面和相邻两行的字节数 (>= 宽度向上取偶)
+//   width, height: 图像宽高
+//   color_space: 颜色矩阵和范围
+//   format: 输出像素格式
+// 输出:
+//   dst, dst_pitch: 输出缓冲区和相邻两行的字节数 (>= width * NV12PixelStride(format))，
+//                   平面格式时为每个平面的行距，三个平面共占 dst_pitch * height * 3 字节
+void NV12ToRGB(const uint8_t* y_plane, int y_pitch, const uint8_t* uv_plane, int uv_pitch, int width, int height,
+               uint8_t* dst, int dst_pitch, NV12ColorSpace color_space = NV12ColorSpace(),
+               NV12PixelFormat format = NV12PixelFormat::RGB24) {
+    NV12ToRGBRows(y_plane, y_pitch, uv_plane, uv_pitch, width, height, 0, height, dst, dst_pitch, color_space, format);
+}
 
 // NV12是YUV420格式，Y平面后接UV交织平面
 // 输入:
 //   nv12_data: NV12格式数据缓冲区
 //   width, height: 图像宽高
+//   color_space: 颜色矩阵和范围，默认 BT.601 limited
+//   format: 输出像素格式，默认RGB24
 // 输出:
-//   rgb_data: 输出的RGB24数据缓冲区（width * height * 3字节）
-void NV12ToRGB(const uint8_t* nv12_data, int width, int height, std::vector<uint8_t>& rgb_data) {
-    rgb_data.resize(width * height * 3);
-    const uint8_t* y_plane = nv12_data;
-    const uint8_t* uv_plane = nv12_data + width * height;
+//   rgb_data: 输出数据缓冲区（width * height * NV12BytesPerPixel(format) 字节）
+void NV12ToRGB(const uint8_t* nv12_data, int width, int height, std::vector<uint8_t>& rgb_data,
+               NV12ColorSpace color_space = NV12ColorSpace(), NV12PixelFormat format = NV12PixelFormat::RGB24) {
+    rgb_data.resize(NV12OutputFrameSize(width, height, format));
+    NV12ToRGB(nv12_data, width, nv12_data + width * height, width, width, height,
+              rgb_data.data(), width * NV12PixelStride(format), color_space, format);
+}
 
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            int y_index = j * width + i;
-            int uv_index = (j / 2) * (width) + (i & ~1);
+// 不分配内存的版本: 输出写入调用者的缓冲区 (通常是 NV12AlignedBuffer，跨帧复用)
+// dst 小于 NV12OutputFrameSize 时不转换，返回false
+bool NV12ToRGB(const uint8_t* nv12_data, int width, int height, NV12ByteSpan dst,
+               NV12ColorSpace color_space = NV12ColorSpace(), NV12PixelFormat format = NV12PixelFormat::RGB24) {
+    if (dst.size < NV12OutputFrameSize(width, height, format)) return false;
+    NV12ToRGB(nv12_data, width, nv12_data + width * height, width, width, height,
+              dst.data, width * NV12PixelStride(format), color_space, format);
+    return true;
+}
 
-            int Y = y_plane[y_index];
-            int U = uv_plane[uv_index] - 128;
-            int V = uv_plane[uv_index + 1] - 128;
+// 常驻线程池: 工作线程只在创建时启动一次，之后每次 Run 只是唤醒它们
+class NV12ThreadPool {
+public:
+    // threads 包括调用 Run 的线程本身，所以只额外创建 threads-1 个工作线程
+    explicit NV12ThreadPool(int threads) {
+        for (int i = 1; i < threads; i++) {
+            workers_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
 
-            // YUV to RGB conversion (BT.601)
-            int C = Y - 16;
-            int D = U;
-            int E = V;
+    ~NV12ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& t : workers_) t.join();
+    }
+
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // 执行 task(0) ~ task(count-1)，调用线程也参与，返回时全部完成
+    void Run(int count, const std::function<void(int)>& task) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        pending_ = count;
+        generation_++;
+        lock.unlock();
+        wake_.notify_all();
 
-            int R = (298 * C + 409 * E + 128) >> 8;
-            int G = (298 * C - 100 * D - 208 * E + 128) >> 8;
-            int B = (298 * C + 516 * D + 128) >> 8;
+        Work(task, count);
 
-            R = std::min(std::max(R, 0), 255);
-            G = std::min(std::max(G, 0), 255);
-            B = std::min(std::max(B, 0), 255);
+        lock.lock();
+        done_.wait(lock, [this] { return pending_ == 0 && active_ == 0; });
+        task_ = nullptr;
+    }
 
-            int rgb_index = y_index * 3;
-            rgb_data[rgb_index + 0] = static_cast<uint8_t>(R);
-            rgb_data[rgb_index + 1] = static_cast<uint8_t>(G);
-            rgb_data[rgb_index + 2] = static_cast<uint8_t>(B);
+private:
+    void Work(const std::function<void(int)>& task, int count) {
+        for (;;) {
+            int i = next_.fetch_add(1);
+            if (i >= count) break;
+            task(i);
+            if (pending_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
         }
     }
+
+    void WorkerLoop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            // 醒得太晚的线程可能看到已经结束的一轮 (task_ 为空)，直接继续等待
+            const std::function<void(int)>* task = task_;
+            int count = count_;
+            if (!task) continue;
+            active_++;
+            lock.unlock();
+            Work(*task, count);
+            lock.lock();
+            active_--;
+            done_.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)>* task_ = nullptr;
+    int count_ = 0;
+    int active_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+    std::atomic<int> next_{0};
+    std::atomic<int> pending_{0};
+};
+
+// 多线程转换参数
+//   threads: 线程数 (包括调用线程)，0 表示使用 CPU 核数
+//   band_height: 每个任务处理的行数，奇数会向上取偶，保证色度行不会被两个线程共用
+struct NV12ParallelOptions {
+    int threads = 0;
+    int band_height = 64;
+};
+
+// 多线程版本: 按水平条带切分整帧，在常驻线程池上并行转换，结果与 NV12ToRGB 完全一致
+// 参数含义与带行距的 NV12ToRGB 相同
+void NV12ToRGBParallel(const uint8_t* y_plane, int y_pitch, const uint8_t* uv_plane, int uv_pitch,
+                       int width, int height, uint8_t* dst, int dst_pitch,
+                       const NV12ParallelOptions& options = NV12ParallelOptions(),
+                       NV12ColorSpace color_space = NV12ColorSpace(),
+                       NV12PixelFormat format = NV12PixelFormat::RGB24) {
+    int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(threads, 1);
+    int band = std::max((options.band_height + 1) & ~1, 2);
+    int bands = (height + band - 1) / band;
+    if (threads == 1 || bands <= 1) {
+        NV12ToRGB(y_plane, y_pitch, uv_plane, uv_pitch, width, height, dst, dst_pitch, color_space, format);
+        return;
+    }
+
+    // 线程池在第一次使用时创建，只有线程数改变时才重建；同一时间只允许一次并行转换
+    static std::mutex pool_mutex;
+    static std::unique_ptr<NV12ThreadPool> pool;
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool || pool->size() != threads) {
+        pool.reset();
+        pool.reset(new NV12ThreadPool(threads));
+    }
+    pool->Run(bands, [&](int b) {
+        NV12ToRGBRows(y_plane, y_pitch, uv_plane, uv_pitch, width, height, b * band, std::min((b + 1) * band, height),
+                      dst, dst_pitch, color_space, format);
+    });
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cout << "Usage: " << argv[0] << " input_nv12_file width height\n";
-        return -1;
+void NV12ToRGBParallel(const uint8_t* nv12_data, int width, int height, std::vector<uint8_t>& rgb_data,
+                       const NV12ParallelOptions& options = NV12ParallelOptions(),
+                       NV12ColorSpace color_space = NV12ColorSpace(),
+                       NV12PixelFormat format = NV12PixelFormat::RGB24) {
+    rgb_data.resize(NV12OutputFrameSize(width, height, format));
+    NV12ToRGBParallel(nv12_data, width, nv12_data + width * height, width, width, height,
+                      rgb_data.data(), width * NV12PixelStride(format), options, color_space, format);
+}
+
+bool NV12ToRGBParallel(const uint8_t* nv12_data, int width, int height, NV12ByteSpan dst,
+                       const NV12ParallelOptions& options = NV12ParallelOptions(),
+                       NV12ColorSpace color_space = NV12ColorSpace(),
+                       NV12PixelFormat format = NV12PixelFormat::RGB24) {
+    if (dst.size < NV12OutputFrameSize(width, height, format)) return false;
+    NV12ToRGBParallel(nv12_data, width, nv12_data + width * height, width, width, height,
+                      dst.data, width * NV12PixelStride(format), options, color_space, format);
+    return true;
+}
+
+// ---- 流式转换 ----
+
+// 从输入来源取出的一帧
+//   data: 帧数据
+//   index: 帧序号，从0开始
+//   buffer: 来源自己分配的缓冲区 (映射文件时为空)
+struct NV12SourceFrame {
+    const uint8_t* data = nullptr;
+    long long index = 0;
+    std::unique_ptr<NV12AlignedBuffer> buffer;
+};
+
+// 输入帧来源: Next 取下一帧，输入结束或出错时返回false；用完的帧必须交给 Release
+// Next 只在一个线程中调用，Release 按帧序号顺序调用，可以在另一个线程
+class NV12FrameSource {
+public:
+    virtual ~NV12FrameSource() {}
+    virtual bool Next(NV12SourceFrame& frame) = 0;
+    virtual void Release(NV12SourceFrame& frame) = 0;
+    virtual const char* name() const = 0;
+    // Next 返回false是因为读出错而不是输入结束
+    virtual bool failed() const { return false; }
+    // 下游出错时从其他线程调用，让阻塞在 Next 中的读入线程尽快返回
+    virtual void Cancel() {}
+};
+
+// 读满一帧，返回实际读到的字节数 (小于 size 表示输入结束)
+static size_t ReadFrame(FILE* in, uint8_t* data, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        size_t n = fread(data + got, 1, size - got, in);
+        if (n == 0) break;
+        got += n;
+    }
+    return got;
+}
+
+static void ReportTruncatedFrame(long long frame, size_t got, size_t frame_size) {
+    std::cerr << "Failed to read full NV12 data (frame " << frame << " has " << got << " of " << frame_size << " bytes)\n";
+}
+
+// 用 fread 读入的来源，可以是管道或stdin
+// 每帧读入帧缓冲池中的一块缓冲区，Release 后放回池中复用，缓冲区数量由流水线深度决定
+class NV12ReadFrameSource : public NV12FrameSource {
+public:
+    // max_frames < 0 表示读到输入结束
+    NV12ReadFrameSource(FILE* in, size_t frame_size, long long max_frames)
+        : in_(in), frame_size_(frame_size), max_frames_(max_frames), pool_(frame_size) {}
+
+    bool Next(NV12SourceFrame& frame) override {
+        if (max_frames_ >= 0 && frames_ >= max_frames_) return false;
+        std::unique_ptr<NV12AlignedBuffer> buf = pool_.Acquire();
+        size_t got = ReadFrame(in_, buf->data(), frame_size_);
+        if (got < frame_size_) {
+            if (ferror(in_)) {
+                std::cerr << "Failed to read input: " << strerror(errno) << "\n";
+                failed_ = true;
+            } else if (got > 0) {
+                ReportTruncatedFrame(frames_, got, frame_size_);
+            }
+            pool_.Release(std::move(buf));
+            return false;
+        }
+        frame.data = buf->data();
+        frame.index = frames_++;
+        frame.buffer = std::move(buf);
+        return true;
+    }
+
+    void Release(NV12SourceFrame& frame) override {
+        if (frame.buffer) pool_.Release(std::move(frame.buffer));
+    }
+
+    const char* name() const override { return "read"; }
+    bool failed() const override { return failed_; }
+
+private:
+    FILE* in_;
+    size_t frame_size_;
+    long long max_frames_;
+    long long frames_ = 0;
+    bool failed_ = false;
+    NV12FramePool pool_;
+};
+
+#ifdef NV12_HAVE_MMAP
+// 内存映射的来源: 转换直接读页缓存，没有用户态拷贝
+//   MADV_SEQUENTIAL 让内核加大预读窗口，并在读过之后尽快回收页面
+//   每帧对后面 kReadAheadFrames 帧做 MADV_WILLNEED，提前发起读盘
+//   已经写出的帧 MADV_DONTNEED 解除映射，多GB的文件常驻内存也保持在几帧以内
+//   MADV_HUGEPAGE 是提示，内核支持只读文件大页 (CONFIG_READ_ONLY_THP_FOR_FS) 时才生效
+class NV12MmapFrameSource : public NV12FrameSource {
+public:
+    static const int kReadAheadFrames = 2;
+
+    NV12MmapFrameSource(size_t frame_size, long long max_frames) : frame_size_(frame_size), max_frames_(max_frames) {}
+
+    ~NV12MmapFrameSource() override {
+        if (map_ != MAP_FAILED) munmap(map_, size_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // 只能映射普通文件，失败时调用者改用 NV12ReadFrameSource
+    bool Open(const char* path) {
+        fd_ = open(path, O_RDONLY);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return false;
+        size_ = static_cast<size_t>(st.st_size);
+        map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map_ == MAP_FAILED) return false;
+        madvise(map_, size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        madvise(map_, size_, MADV_HUGEPAGE);
+#endif
+        page_size_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        WillNeed(0, std::min(size_, frame_size_ * (kReadAheadFrames + 1)));
+        return true;
     }
 
-    const char* input_file = argv[1];
-    int width = atoi(argv[2]);
-    int height = atoi(argv[3]);
+    bool Next(NV12SourceFrame& frame) override {
+        if (max_frames_ >= 0 && frames_ >= max_frames_) return false;
+        size_t offset = static_cast<size_t>(frames_) * frame_size_;
+        if (offset + frame_size_ > size_) {
+            if (offset < size_) ReportTruncatedFrame(frames_, size_ - offset, frame_size_);
+            return false;
+        }
+        // 当前帧和后面 kReadAheadFrames 帧已经预读过，这里只需要把窗口再往后推一帧
+        size_t ahead = offset + frame_size_ * (kReadAheadFrames + 1);
+        if (ahead < size_) WillNeed(ahead, std::min(frame_size_, size_ - ahead));
+        frame.data = static_cast<const uint8_t*>(map_) + offset;
+        frame.index = frames_++;
+        return true;
+    }
+
+    // 按顺序释放，所以这一帧结束位置之前的整页都不会再用到
+    void Release(NV12SourceFrame& frame) override {
+        size_t end = static_cast<size_t>(frame.index + 1) * frame_size_ / page_size_ * page_size_;
+        if (end > released_) {
+            madvise(static_cast<uint8_t*>(map_) + released_, end - released_, MADV_DONTNEED);
+            released_ = end;
+        }
+    }
+
+    const char* name() const override { return "mmap"; }
+
+private:
+    void WillNeed(size_t offset, size_t length) {
+        size_t begin = offset / page_size_ * page_size_;
+        madvise(static_cast<uint8_t*>(map_) + begin, offset + length - begin, MADV_WILLNEED);
+    }
+
+    size_t frame_size_;
+    long long max_frames_;
+    long long frames_ = 0;
+    int fd_ = -1;
+    void* map_ = MAP_FAILED;
+    size_t size_ = 0;
+    size_t page_size_ = 4096;
+    size_t released_ = 0;
+};
+#endif
+
+// 输出去处: 转换线程用 Acquire 取输出缓冲区，写出线程按帧序调用 Write 交回
+// Write 返回后缓冲区可能还在异步写出，写完才会被 Acquire 再次取到
+class NV12FrameSink {
+public:
+    virtual ~NV12FrameSink() {}
+    virtual std::unique_ptr<NV12AlignedBuffer> Acquire() = 0;
+    virtual bool Write(std::unique_ptr<NV12AlignedBuffer> buf) = 0;
+    // 等待所有写出完成
+    virtual bool Flush() = 0;
+    virtual const char* name() const = 0;
+};
+
+// 用 fwrite 写出，可以是文件、管道或stdout
+class NV12StdioFrameSink : public NV12FrameSink {
+public:
+    NV12StdioFrameSink(FILE* out, size_t frame_size) : out_(out), pool_(frame_size) {}
+
+    std::unique_ptr<NV12AlignedBuffer> Acquire() override { return pool_.Acquire(); }
+
+    bool Write(std::unique_ptr<NV12AlignedBuffer> buf) override {
+        bool ok = fwrite(buf->data(), 1, buf->size(), out_) == buf->size();
+        pool_.Release(std::move(buf));
+        return ok;
+    }
+
+    bool Flush() override { return fflush(out_) == 0; }
+    const char* name() const override { return "stdio"; }
+
+private:
+    FILE* out_;
+    NV12FramePool pool_;
+};
+
+#ifdef NV12_HAVE_IO_URING
+// ---- io_uring ----
+//
+// 每帧一个 READ_FIXED / WRITE_FIXED 请求，缓冲区预先注册给内核 (省掉每次请求的页面锁定)，
+// 同时保持多个请求在途。帧大小和文件偏移都按 kDirectAlignment 对齐时用 O_DIRECT 绕过页缓存。
+// 只用于普通文件 (按偏移读写，请求可以乱序完成)，管道和stdin/stdout仍然用stdio。
+
+static const size_t kDirectAlignment = 4096;
+
+// 最小的 io_uring 封装: 一个提交队列和一个完成队列，只在一个线程中使用
+class NV12Uring {
+public:
+    ~NV12Uring() {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_) munmap(sq_ptr_, sq_size_);
+        if (fd_ >= 0) close(fd_);
+    }
 
-    // 计算NV12数据大小
-    size_t nv12_size = width * height * 3 / 2;
+    bool Init(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return false;
 
-    std::vector<uint8_t> nv12_data(nv12_size);
-    std::ifstream fin(input_file, std::ios::binary);
-    if (!fin) {
-        std::cerr << "Failed to open input file\n";
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        sq_ptr_ = MapRing(sq_size_, IORING_OFF_SQ_RING);
+        if (!sq_ptr_) return false;
+        cq_ptr_ = single ? sq_ptr_ : MapRing(cq_size_, IORING_OFF_CQ_RING);
+        if (!cq_ptr_) return false;
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(MapRing(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) return false;
+
+        uint8_t* sq = static_cast<uint8_t*>(sq_ptr_);
+        uint8_t* cq = static_cast<uint8_t*>(cq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        entries_ = p.sq_entries;
+        local_tail_ = *sq_tail_;
+        return true;
+    }
+
+    bool RegisterBuffers(const iovec* iov, unsigned count) {
+        return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iov, count) == 0;
+    }
+
+    // 固定缓冲区读写请求，提交队列满时返回false
+    bool PrepFixed(uint8_t opcode, int fd, void* buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data) {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (local_tail_ - head >= entries_) return false;
+        unsigned idx = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = static_cast<unsigned>(len);
+        sqe->off = offset;
+        sqe->buf_index = static_cast<uint16_t>(buf_index);
+        sqe->user_data = user_data;
+        sq_array_[idx] = idx;
+        local_tail_++;
+        return true;
+    }
+
+    // 提交所有新请求，并等待至少 wait 个完成
+    bool Submit(unsigned wait) {
+        __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+        unsigned to_submit = local_tail_ - submitted_;
+        for (;;) {
+            long r = syscall(__NR_io_uring_enter, fd_, to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (r >= 0) {
+                submitted_ += static_cast<unsigned>(r);
+                to_submit -= static_cast<unsigned>(r);
+                if (to_submit == 0) return true;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+    bool PeekCompletion(io_uring_cqe& cqe) {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+        cqe = cqes_[head & cq_mask_];
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* MapRing(size_t size, off_t offset) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_size_ = 0, cq_size_ = 0, sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned sq_mask_ = 0, cq_mask_ = 0, entries_ = 0;
+    unsigned local_tail_ = 0, submitted_ = 0;
+};
+
+// 打开普通文件，能用 O_DIRECT 时优先使用 (有的文件系统如tmpfs不支持，退回普通IO)
+static int OpenMaybeDirect(const char* path, int flags, bool want_direct, bool& direct) {
+    direct = false;
+    if (want_direct) {
+        int fd = open(path, flags | O_DIRECT, 0644);
+        if (fd >= 0) {
+            direct = true;
+            return fd;
+        }
+    }
+    return open(path, flags, 0644);
+}
+
+// io_uring 读入: 注册 slots 块缓冲区，最多 kReadsInFlight 个读请求同时在途
+class NV12UringFrameSource : public NV12FrameSource {
+public:
+    static const int kReadsInFlight = 4;
+
+    NV12UringFrameSource(size_t frame_size, long long max_frames) : frame_size_(frame_size), max_frames_(max_frames) {}
+
+    ~NV12UringFrameSource() override {
+        // 在途的请求必须先完成，内核还在往缓冲区里写
+        while (in_flight_ > 0 && ring_.Submit(1)) Reap();
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // slots: 缓冲区数量，应不少于流水线中同时存在的帧数 + kReadsInFlight
+    bool Open(const char* path, int slots) {
+        bool want_direct = frame_size_ % kDirectAlignment == 0;
+        fd_ = OpenMaybeDirect(path, O_RDONLY, want_direct, direct_);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+        file_size_ = static_cast<size_t>(st.st_size);
+        total_ = static_cast<long long>(file_size_ / frame_size_);
+        if (max_frames_ >= 0) total_ = std::min(total_, max_frames_);
+        if (!ring_.Init(kReadsInFlight * 2)) return false;
+
+        std::vector<iovec> iov(slots);
+        for (int i = 0; i < slots; i++) {
+            buffers_.emplace_back(new NV12AlignedBuffer(frame_size_, kDirectAlignment));
+            iov[i].iov_base = buffers_[i]->data();
+            iov[i].iov_len = buffers_[i]->capacity();
+            free_.push_back(i);
+        }
+        slot_frame_.assign(slots, -1);
+        slot_done_.assign(slots, 0);
+        return ring_.RegisterBuffers(iov.data(), static_cast<unsigned>(slots));
+    }
+
+    bool Next(NV12SourceFrame& frame) override {
+        if (failed_) return false;
+        if (next_ >= total_) {
+            size_t offset = static_cast<size_t>(total_) * frame_size_;
+            if ((max_frames_ < 0 || total_ < max_frames_) && offset < file_size_) {
+                ReportTruncatedFrame(total_, file_size_ - offset, frame_size_);
+            }
+            return false;
+        }
+        for (;;) {
+            SubmitReads();
+            int slot = LockedFindSlot(next_);
+            if (slot >= 0 && slot_done_[slot] == frame_size_) {
+                frame.data = buffers_[slot]->data();
+                frame.index = next_++;
+                return true;
+            }
+            if (in_flight_ > 0) {
+                if (!ring_.Submit(1)) return Fail(errno);
+                if (!Reap()) return false;
+            } else {
+                // 没有空闲缓冲区，等写出线程 Release
+                std::unique_lock<std::mutex> lock(mutex_);
+                released_cv_.wait(lock, [this] { return !free_.empty() || cancelled_; });
+                if (cancelled_) return false;
+            }
+        }
+    }
+
+    void Release(NV12SourceFrame& frame) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int slot = FindSlot(frame.index);
+        slot_frame_[slot] = -1;
+        free_.push_back(slot);
+        released_cv_.notify_one();
+    }
+
+    void Cancel() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        released_cv_.notify_all();
+    }
+
+    const char* name() const override { return direct_ ? "io_uring+O_DIRECT" : "io_uring"; }
+    bool failed() const override { return failed_; }
+
+private:
+    int LockedFindSlot(long long index) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return FindSlot(index);
+    }
+
+    int FindSlot(long long index) {
+        for (size_t i = 0; i < slot_frame_.size(); i++) {
+            if (slot_frame_[i] == index) return static_cast<int>(i);
+        }
         return -1;
     }
 
-    fin.read(reinterpret_cast<char*>(nv12_data.data()), nv12_size);
-    if (!fin) {
+    void SubmitReads() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (in_flight_ < kReadsInFlight && submit_ < total_ && !free_.empty()) {
+            int slot = free_.back();
+            free_.pop_back();
+            slot_frame_[slot] = submit_++;
+            slot_done_[slot] = 0;
+            PrepRead(slot);
+        }
+    }
+
+    void PrepRead(int slot) {
+        size_t done = slot_done_[slot];
+        uint64_t offset = static_cast<uint64_t>(slot_frame_[slot]) * frame_size_ + done;
+        ring_.PrepFixed(IORING_OP_READ_FIXED, fd_, buffers_[slot]->data() + done, frame_size_ - done, offset, slot, slot);
+        in_flight_++;
+    }
+
+    bool Reap() {
+        io_uring_cqe cqe;
+        while (ring_.PeekCompletion(cqe)) {
+            int slot = static_cast<int>(cqe.user_data);
+            in_flight_--;
+            if (cqe.res <= 0) return Fail(cqe.res < 0 ? -cqe.res : EIO);
+            slot_done_[slot] += static_cast<size_t>(cqe.res);
+            // 读到的比请求的少 (很少见)，接着读剩下的部分
+            if (slot_done_[slot] < frame_size_) PrepRead(slot);
+        }
+        return true;
+    }
+
+    bool Fail(int err) {
+        if (!failed_) std::cerr << "io_uring read failed: " << strerror(err) << "\n";
+        failed_ = true;
+        return false;
+    }
+
+    size_t frame_size_;
+    long long max_frames_;
+    int fd_ = -1;
+    bool direct_ = false;
+    bool failed_ = false;
+    size_t file_size_ = 0;
+    long long total_ = 0;
+    long long next_ = 0;        // 下一个交给调用者的帧
+    long long submit_ = 0;      // 下一个要提交读请求的帧
+    int in_flight_ = 0;
+    NV12Uring ring_;
+    std::vector<std::unique_ptr<NV12AlignedBuffer>> buffers_;
+    std::vector<long long> slot_frame_;   // 每块缓冲区中的帧序号，-1为空闲
+    std::vector<size_t> slot_done_;       // 已经读入的字节数
+    std::vector<int> free_;
+    bool cancelled_ = false;
+    std::mutex mutex_;                    // 保护 free_、slot_frame_ 和 cancelled_ (Release/Cancel 在其他线程调用)
+    std::condition_variable released_cv_;
+};
+
+// io_uring 写出: 注册 slots 块输出缓冲区，最多 kWritesInFlight 个写请求同时在途
+class NV12UringFrameSink : public NV12FrameSink {
+public:
+    static const int kWritesInFlight = 4;
+
+    explicit NV12UringFrameSink(size_t frame_size) : frame_size_(frame_size) {}
+
+    ~NV12UringFrameSink() override {
+        while (in_flight_ > 0 && ring_.Submit(1)) Reap();
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // slots: 缓冲区数量，应不少于流水线中同时存在的输出帧数 + kWritesInFlight
+    bool Open(const char* path, int slots) {
+        bool want_direct = frame_size_ % kDirectAlignment == 0;
+        fd_ = OpenMaybeDirect(path, O_WRONLY | O_CREAT | O_TRUNC, want_direct, direct_);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+        if (!ring_.Init(kWritesInFlight * 2)) return false;
+
+        std::vector<iovec> iov(slots);
+        for (int i = 0; i < slots; i++) {
+            std::unique_ptr<NV12AlignedBuffer> buf(new NV12AlignedBuffer(frame_size_, kDirectAlignment));
+            iov[i].iov_base = buf->data();
+            iov[i].iov_len = buf->capacity();
+            slot_data_.push_back(buf->data());
+            free_.push_back(std::move(buf));
+        }
+        writing_.resize(slots);
+        slot_offset_.assign(slots, 0);
+        slot_done_.assign(slots, 0);
+        return ring_.RegisterBuffers(iov.data(), static_cast<unsigned>(slots));
+    }
+
+    std::unique_ptr<NV12AlignedBuffer> Acquire() override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        free_cv_.wait(lock, [this] { return !free_.empty() || failed_; });
+        // 写出已经失败，不会再有缓冲区归还，给个普通缓冲区让转换线程走完
+        if (free_.empty()) return std::unique_ptr<NV12AlignedBuffer>(new NV12AlignedBuffer(frame_size_));
+        std::unique_ptr<NV12AlignedBuffer> buf = std::move(free_.back());
+        free_.pop_back();
+        return buf;
+    }
+
+    bool Write(std::unique_ptr<NV12AlignedBuffer> buf) override {
+        if (failed()) return false;
+        int slot = static_cast<int>(std::find(slot_data_.begin(), slot_data_.end(), buf->data()) - slot_data_.begin());
+        slot_offset_[slot] = static_cast<uint64_t>(frames_++) * frame_size_;
+        slot_done_[slot] = 0;
+        writing_[slot] = std::move(buf);
+        PrepWrite(slot);
+        if (!ring_.Submit(in_flight_ >= kWritesInFlight ? 1 : 0)) return Fail(errno);
+        return Reap();
+    }
+
+    bool Flush() override {
+        while (in_flight_ > 0 && !failed()) {
+            if (!ring_.Submit(1)) return Fail(errno);
+            if (!Reap()) return false;
+        }
+        return !failed();
+    }
+
+    const char* name() const override { return direct_ ? "io_uring+O_DIRECT" : "io_uring"; }
+
+private:
+    void PrepWrite(int slot) {
+        size_t done = slot_done_[slot];
+        ring_.PrepFixed(IORING_OP_WRITE_FIXED, fd_, slot_data_[slot] + done, frame_size_ - done,
+                        slot_offset_[slot] + done, slot, slot);
+        in_flight_++;
+    }
+
+    bool Reap() {
+        io_uring_cqe cqe;
+        while (ring_.PeekCompletion(cqe)) {
+            int slot = static_cast<int>(cqe.user_data);
+            in_flight_--;
+            if (cqe.res <= 0) return Fail(cqe.res < 0 ? -cqe.res : EIO);
+            slot_done_[slot] += static_cast<size_t>(cqe.res);
+            if (slot_done_[slot] < frame_size_) {
+                PrepWrite(slot);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(std::move(writing_[slot]));
+            free_cv_.notify_one();
+        }
+        return true;
+    }
+
+    bool Fail(int err) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!failed_) std::cerr << "io_uring write failed: " << strerror(err) << "\n";
+        failed_ = true;
+        free_cv_.notify_all();
+        return false;
+    }
+
+    bool failed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+
+    size_t frame_size_;
+    int fd_ = -1;
+    bool direct_ = false;
+    bool failed_ = false;
+    long long frames_ = 0;
+    int in_flight_ = 0;
+    NV12Uring ring_;
+    std::vector<uint8_t*> slot_data_;
+    std::vector<std::unique_ptr<NV12AlignedBuffer>> writing_;   // 正在写出的缓冲区
+    std::vector<uint64_t> slot_offset_;
+    std::vector<size_t> slot_done_;
+    std::vector<std::unique_ptr<NV12AlignedBuffer>> free_;
+    std::mutex mutex_;                                          // 保护 free_ 和 failed_ (Acquire 在转换线程调用)
+    std::condition_variable free_cv_;
+};
+#endif
+
+// 其他程序 (如 nv12_to_rgb_bench.cpp) 直接包含本文件使用转换函数时定义 NV12_TO_RGB_NO_MAIN，
+// 下面的流水线和命令行只有本程序自己用
+#ifndef NV12_TO_RGB_NO_MAIN
+// 有界阻塞队列: 满时 Push 阻塞，空时 Pop 阻塞
+// Close 之后 Push 返回false，Pop 取完剩余元素后返回false
+template <typename T>
+class NV12BoundedQueue {
+public:
+    explicit NV12BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+// 流水线参数
+//   converters: 转换线程数，每个线程一次转换一整帧
+//   queue_depth: 读入队列和待写出帧的上限，内存占用固定为 O(queue_depth + converters) 帧
+//   frame: 每帧内部的并行参数，只有一个转换线程时才值得在帧内再按条带并行
+struct NV12PipelineOptions {
+    int converters = 1;
+    int queue_depth = 4;
+    NV12ParallelOptions frame;
+};
+
+// 三级流水线: 读入线程 -> converters 个转换线程 -> 按帧序写出 (调用线程)
+// 读盘、转换、写盘同时进行，长时间的采集文件可以跑满磁盘或者CPU，而不是两者交替空闲
+// 返回成功写出的帧数，出错时返回 -1
+static long long PipelineConvert(NV12FrameSource& source, NV12FrameSink& sink, int width, int height,
+                                 const NV12PipelineOptions& options, NV12ColorSpace color_space, NV12PixelFormat format) {
+    struct Job {
+        NV12SourceFrame input;
+        std::unique_ptr<NV12AlignedBuffer> output;
+    };
+
+    int converters = std::max(options.converters, 1);
+    long long depth = std::max(options.queue_depth, 1);
+    NV12BoundedQueue<Job> convert_queue(depth);
+
+    // 转换完成、等待按顺序写出的帧；转换线程最多领先写出位置 depth 帧
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::map<long long, Job> done;
+    long long next_write = 0;
+    long long total = -1;           // 读入结束后为总帧数
+    bool failed = false;
+
+    std::thread reader([&] {
+        long long count = 0;
+        for (;;) {
+            Job job;
+            if (!source.Next(job.input)) break;
+            if (!convert_queue.Push(std::move(job))) break;
+            count++;
+        }
+        convert_queue.Close();
+        std::lock_guard<std::mutex> lock(mutex);
+        total = count;
+        cv.notify_all();
+    });
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < converters; i++) {
+        workers.emplace_back([&] {
+            Job job;
+            while (convert_queue.Pop(job)) {
+                job.output = sink.Acquire();
+                NV12ToRGBParallel(job.input.data, width, height, job.output->span(), options.frame, color_space, format);
+                long long index = job.input.index;
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return index < next_write + depth || failed; });
+                if (failed) break;
+                done.emplace(index, std::move(job));
+                cv.notify_all();
+            }
+        });
+    }
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return done.count(next_write) || next_write == total; });
+            if (next_write == total) break;
+            auto it = done.find(next_write);
+            job = std::move(it->second);
+            done.erase(it);
+        }
+        bool ok = sink.Write(std::move(job.output));
+        source.Release(job.input);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) {
+            std::cerr << "Failed to write output\n";
+            failed = true;
+        } else {
+            next_write++;
+        }
+        cv.notify_all();
+        if (failed) break;
+    }
+
+    // 出错时关闭队列、取消读入，让读入线程和转换线程尽快退出
+    if (failed) {
+        convert_queue.Close();
+        source.Cancel();
+    }
+    reader.join();
+    for (std::thread& t : workers) t.join();
+
+    if (!failed && !sink.Flush()) {
+        std::cerr << "Failed to write output\n";
+        failed = true;
+    }
+    if (failed || source.failed()) return -1;
+    if (next_write == 0) {
         std::cerr << "Failed to read full NV12 data\n";
         return -1;
     }
-    fin.close();
+    return next_write;
+}
+
+static void PrintUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] input_nv12_file width height [threads] [band_height]\n";
+    std::cout << "  input_nv12_file: - reads from stdin\n";
+    std::cout << "  threads: 0 = all cores (default), 1 = single-threaded\n";
+    std::cout << "           with --stream each thread converts whole frames, otherwise the frame is split into bands\n";
+    std::cout << "  --matrix=bt601|bt709|bt2020  color matrix (default bt601)\n";
+    std::cout << "  --range=limited|full         YUV range (default limited)\n";
+    std::cout << "  --format=rgb24|bgr24|rgba32|bgra32|argb32|rgb565|planar\n";
+    std::cout << "                               output pixel format (default rgb24)\n";
+    std::cout << "  --output=FILE                output file (default output.rgb), - writes to stdout\n";
+    std::cout << "  --stream                     convert every frame of the input, not just the first\n";
+    std::cout << "  --io=auto|mmap|read|uring    I/O path (default auto: mmap for regular input files, read otherwise;\n";
+    std::cout << "                               uring: io_uring reads and writes for regular files, O_DIRECT when\n";
+    std::cout << "                               the frame size is a multiple of 4096)\n";
+    std::cout << "  --queue-depth=N              frames buffered between pipeline stages (default 2 * threads)\n";
+}
+
+int main(int argc, char* argv[]) {
+    // 以 -- 开头的是选项，其余按顺序作为位置参数
+    std::vector<const char*> args;
+    NV12ColorSpace color_space;
+    NV12PixelFormat format = NV12PixelFormat::RGB24;
+    const char* output_file = "output.rgb";
+    bool stream = false;
+    const char* io = "auto";
+    int queue_depth = 0;
+    for (int i = 1; i < argc; i++) {
+        bool ok = true;
+        if (strncmp(argv[i], "--matrix=", 9) == 0) {
+            ok = NV12ParseColorSpace(argv[i] + 9, nullptr, color_space);
+        } else if (strncmp(argv[i], "--range=", 8) == 0) {
+            ok = NV12ParseColorSpace(nullptr, argv[i] + 8, color_space);
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            ok = NV12ParsePixelFormat(argv[i] + 9, format);
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            output_file = argv[i] + 9;
+            ok = *output_file != '\0';
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (strncmp(argv[i], "--io=", 5) == 0) {
+            io = argv[i] + 5;
+            ok = strcmp(io, "auto") == 0 || strcmp(io, "mmap") == 0 || strcmp(io, "read") == 0 ||
+                 strcmp(io, "uring") == 0;
+        } else if (strncmp(argv[i], "--queue-depth=", 14) == 0) {
+            queue_depth = atoi(argv[i] + 14);
+            ok = queue_depth > 0;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            ok = false;
+        } else {
+            args.push_back(argv[i]);
+        }
+        if (!ok) {
+            std::cerr << "Invalid option " << argv[i] << "\n";
+            PrintUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (args.size() < 3 || args.size() > 5) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    const char* input_file = args[0];
+    int width = atoi(args[1]);
+    int height = atoi(args[2]);
+    NV12ParallelOptions options;
+    if (args.size() >= 4) options.threads = atoi(args[3]);
+    if (args.size() >= 5) options.band_height = atoi(args[4]);
+    if (width <= 0 || height <= 0) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    bool from_stdin = strcmp(input_file, "-") == 0;
+    bool to_stdout = strcmp(output_file, "-") == 0;
+    size_t nv12_size = NV12FrameSize(width, height);
+    long long max_frames = stream ? -1 : 1;
+
+    // 多帧时按帧并行 (每个转换线程一次一帧)，单帧时只有一个转换线程，在帧内按条带并行
+    NV12PipelineOptions pipeline;
+    if (stream) {
+        int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+        pipeline.converters = std::max(threads, 1);
+        pipeline.frame = options;
+        pipeline.frame.threads = 1;
+    } else {
+        pipeline.converters = 1;
+        pipeline.frame = options;
+    }
+    pipeline.queue_depth = queue_depth > 0 ? queue_depth : 2 * pipeline.converters;
+
+    std::unique_ptr<NV12FrameSource> source;
+    std::unique_ptr<NV12FrameSink> sink;
+    FILE* fin = nullptr;
+    FILE* fout = nullptr;
+    bool uring = strcmp(io, "uring") == 0;
+#ifdef NV12_HAVE_IO_URING
+    // io_uring 只用于普通文件；内核不支持 (或被禁用) 时退回 read/fwrite
+    if (uring) {
+        // 读入帧: 读入线程手上1帧 + 转换队列 + 转换中 + 待写出 + 正在写出1帧，再加上在途的读请求
+        int source_slots = 2 * pipeline.queue_depth + pipeline.converters + 2 + NV12UringFrameSource::kReadsInFlight;
+        std::unique_ptr<NV12UringFrameSource> uring_source(new NV12UringFrameSource(nv12_size, max_frames));
+        if (!from_stdin && uring_source->Open(input_file, source_slots)) {
+            source = std::move(uring_source);
+        } else {
+            std::cerr << "io_uring input unavailable, falling back to read\n";
+        }
+        // 输出帧: 转换中 + 待写出，再加上在途的写请求
+        int sink_slots = pipeline.queue_depth + pipeline.converters + 1 + NV12UringFrameSink::kWritesInFlight;
+        std::unique_ptr<NV12UringFrameSink> uring_sink(new NV12UringFrameSink(NV12OutputFrameSize(width, height, format)));
+        if (!to_stdout && uring_sink->Open(output_file, sink_slots)) {
+            sink = std::move(uring_sink);
+        } else {
+            std::cerr << "io_uring output unavailable, falling back to stdio\n";
+        }
+    }
+#else
+    if (uring) std::cerr << "io_uring is not supported on this platform, falling back to read/stdio\n";
+#endif
+#ifdef NV12_HAVE_MMAP
+    if (!source && !uring && strcmp(io, "read") != 0) {
+        std::unique_ptr<NV12MmapFrameSource> mapped(new NV12MmapFrameSource(nv12_size, max_frames));
+        if (!from_stdin && mapped->Open(input_file)) {
+            source = std::move(mapped);
+        } else if (strcmp(io, "mmap") == 0) {
+            std::cerr << "Failed to mmap input file\n";
+            return -1;
+        }
+    }
+#else
+    if (strcmp(io, "mmap") == 0) {
+        std::cerr << "mmap input is not supported on this platform\n";
+        return -1;
+    }
+#endif
+    if (!source) {
+        fin = from_stdin ? stdin : fopen(input_file, "rb");
+        if (!fin) {
+            std::cerr << "Failed to open input file\n";
+            return -1;
+        }
+        source.reset(new NV12ReadFrameSource(fin, nv12_size, max_frames));
+    }
 
-    std::vector<uint8_t> rgb_data;
-    NV12ToRGB(nv12_data.data(), width, height, rgb_data);
+    if (!sink) {
+        fout = to_stdout ? stdout : fopen(output_file, "wb");
+        if (!fout) {
+            std::cerr << "Failed to open output file\n";
+            source.reset();
+            if (fin && !from_stdin) fclose(fin);
+            return -1;
+        }
+        sink.reset(new NV12StdioFrameSink(fout, NV12OutputFrameSize(width, height, format)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long long frames = PipelineConvert(*source, *sink, width, height, pipeline, color_space, format);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    // 输出RGB到文件
-    std::ofstream fout("output.rgb", std::ios::binary);
-    fout.write(reinterpret_cast<const char*>(rgb_data.data()), rgb_data.size());
-    fout.close();
+    std::string io_name = std::string(source->name()) + " -> " + sink->name();
+    source.reset();
+    sink.reset();
+    if (fin && !from_stdin) fclose(fin);
+    bool closed = !fout || (to_stdout ? fflush(fout) == 0 : fclose(fout) == 0);
+    if (frames < 0) return -1;
+    if (!closed) {
+        std::cerr << "Failed to write output\n";
+        return -1;
+    }
 
-    std::cout << "Conversion done, output.rgb generated (" << rgb_data.size() << " bytes)\n";
+    // 输出写到stdout时，状态信息改写到stderr，不混进数据流
+    std::ostream& log = to_stdout ? std::cerr : std::cout;
+    log << "Conversion done, " << (to_stdout ? "stdout" : output_file) << " generated ("
+        << frames * static_cast<long long>(NV12OutputFrameSize(width, height, format)) << " bytes, " << frames
+        << (frames == 1 ? " frame, " : " frames, ") << g_nv12_kernel.name << ", "
+        << NV12MatrixName(color_space.matrix) << " " << NV12RangeName(color_space.range) << ", "
+        << NV12PixelFormatName(format) << ")\n";
+    // 吞吐量 (包括读盘和写出)，用 --io=read / --io=mmap / --io=uring 对比不同的IO方式
+    log << "Throughput (" << io_name << "): " << frames << (frames == 1 ? " frame in " : " frames in ") << seconds * 1000.0
+        << " ms, " << frames / seconds << " fps, " << frames * static_cast<double>(nv12_size) / seconds / 1e6
+        << " MB/s input\n";
     return 0;
 }
-
+#endif
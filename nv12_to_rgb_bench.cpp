@@ -0,0 +1,227 @@
+// nv12_to_rgb_bench.cpp
+// nv12_to_rgb.cpp 中各转换内核和多线程版本的微基准 (Google Benchmark)
+//
+// Build:
+// g++ -O2 -std=c++17 -pthread nv12_to_rgb_bench.cpp -lbenchmark -o nv12_to_rgb_bench
+//
+// Run:
+// ./nv12_to_rgb_bench                                          (全部组合，耗时几分钟)
+// ./nv12_to_rgb_bench --benchmark_filter='avx2/rgb24/.*'         (只跑一个内核、一种格式)
+// ./nv12_to_rgb_bench --benchmark_filter='1920x1080' --benchmark_format=csv
+//
+// 基准名称: <内核>/<输出格式>/<宽>x<高>，多线程版本为 parallel:<线程数>/<输出格式>/<宽>x<高>
+// 每项报告:
+//   Mpix/s        每秒转换的像素数 (按墙钟时间)
+//   bytes_per_second  读入的NV12加写出的RGB字节数
+//   bytes/cycle   同上，按CPU周期计 (所有线程的周期合计)
+//   cache-misses/frame  每帧的最后一级缓存未命中次数 (所有线程合计)
+// 周期数和缓存未命中来自 perf_event 硬件计数器；虚拟机或 perf_event_paranoid 限制下不可用时，
+// bytes/cycle 改用TSC参考周期 (x86，按墙钟计，多线程时不是合计)，不报告缓存未命中。
+
+#define NV12_TO_RGB_NO_MAIN
+#include "nv12_to_rgb.cpp"
+
+#include <benchmark/benchmark.h>
+
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string>
+
+#ifdef NV12_HAVE_X86
+#include <x86intrin.h>
+#endif
+
+struct NV12BenchResolution {
+    int width;
+    int height;
+};
+
+static const NV12BenchResolution kResolutions[] = {
+    { 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 },
+};
+
+// 一组硬件计数器: 每个线程一个 cycles 和一个 cache-misses，Start/Stop 之间的计数累加
+// 线程池在第一次转换时创建，所以在预热之后再 Open，才能覆盖到所有工作线程
+class NV12PerfCounters {
+public:
+    ~NV12PerfCounters() {
+        for (int fd : fds_) close(fd);
+    }
+
+    // 为进程中当前的每个线程打开计数器，任何一个打不开就全部放弃
+    bool Open() {
+        DIR* dir = opendir("/proc/self/task");
+        if (!dir) return false;
+        bool ok = true;
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') continue;
+            pid_t tid = static_cast<pid_t>(atoi(entry->d_name));
+            int cycles = OpenCounter(tid, PERF_COUNT_HW_CPU_CYCLES);
+            int misses = cycles >= 0 ? OpenCounter(tid, PERF_COUNT_HW_CACHE_MISSES) : -1;
+            if (cycles >= 0) fds_.push_back(cycles);
+            if (misses >= 0) fds_.push_back(misses);
+            if (misses < 0) {
+                ok = false;
+                break;
+            }
+        }
+        closedir(dir);
+        if (!ok) {
+            for (int fd : fds_) close(fd);
+            fds_.clear();
+        }
+        return ok;
+    }
+
+    void Start() {
+        for (int fd : fds_) ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        for (int fd : fds_) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    // 返回 Start 以来所有线程的周期数和缓存未命中数
+    void Stop(uint64_t& cycles, uint64_t& misses) {
+        cycles = misses = 0;
+        for (size_t i = 0; i < fds_.size(); i++) {
+            ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t value = 0;
+            if (read(fds_[i], &value, sizeof(value)) != sizeof(value)) value = 0;
+            (i % 2 == 0 ? cycles : misses) += value;
+        }
+    }
+
+private:
+    static int OpenCounter(pid_t tid, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0));
+    }
+
+    std::vector<int> fds_;
+};
+
+static bool g_perf_available = false;
+
+static uint64_t ReferenceCycles() {
+#ifdef NV12_HAVE_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 随机内容的NV12帧 (固定种子)，避免全零输入让分支或缓存表现不真实
+static void FillNV12(NV12AlignedBuffer& frame) {
+    uint32_t state = 12345;
+    uint8_t* p = frame.data();
+    for (size_t i = 0; i < frame.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        p[i] = static_cast<uint8_t>(state >> 24);
+    }
+}
+
+// 反复用 convert 转换同一帧，输入输出缓冲区在计时之外分配
+static void RunConversion(benchmark::State& state, int width, int height, NV12PixelFormat format,
+                          const std::function<void(const uint8_t*, uint8_t*)>& convert) {
+    NV12AlignedBuffer input(NV12FrameSize(width, height));
+    NV12AlignedBuffer output(NV12OutputFrameSize(width, height, format));
+    FillNV12(input);
+    // 预热: 页面已在分配时触碰，这里再让线程池 (如果有) 启动
+    convert(input.data(), output.data());
+
+    NV12PerfCounters perf;
+    bool use_perf = g_perf_available && perf.Open();
+    if (use_perf) perf.Start();
+    uint64_t tsc_start = ReferenceCycles();
+    for (auto _ : state) {
+        convert(input.data(), output.data());
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    uint64_t cycles = ReferenceCycles() - tsc_start;
+    uint64_t misses = 0;
+    if (use_perf) perf.Stop(cycles, misses);
+
+    double frames = static_cast<double>(state.iterations());
+    double frame_bytes = static_cast<double>(input.size() + output.size());
+    state.SetBytesProcessed(static_cast<int64_t>(frames * frame_bytes));
+    state.counters["Mpix/s"] = benchmark::Counter(frames * width * height / 1e6, benchmark::Counter::kIsRate);
+    if (cycles > 0) state.counters["bytes/cycle"] = frames * frame_bytes / static_cast<double>(cycles);
+    if (use_perf) state.counters["cache-misses/frame"] = static_cast<double>(misses) / frames;
+}
+
+static std::string BenchName(const std::string& variant, NV12PixelFormat format, const NV12BenchResolution& res) {
+    return variant + "/" + NV12PixelFormatName(format) + "/" + std::to_string(res.width) + "x" +
+           std::to_string(res.height);
+}
+
+static void RegisterBenchmarks() {
+    const NV12ColorSpace color_space;
+
+    // 单线程: 每个CPU支持的内核 (包括标量的 c 和查表的 lut)
+    for (const NV12Kernel& kernel : kNV12Kernels) {
+        if (!kernel.supported()) continue;
+        const NV12Kernel* k = &kernel;
+        for (int f = 0; f < kNV12PixelFormatCount; f++) {
+            NV12PixelFormat format = static_cast<NV12PixelFormat>(f);
+            for (const NV12BenchResolution& res : kResolutions) {
+                int w = res.width, h = res.height;
+                benchmark::RegisterBenchmark(BenchName(kernel.name, format, res).c_str(),
+                    [=](benchmark::State& state) {
+                        RunConversion(state, w, h, format, [&](const uint8_t* in, uint8_t* out) {
+                            NV12ToRGBRows(in, w, in + static_cast<size_t>(w) * h, w, w, h, 0, h,
+                                          out, w * NV12PixelStride(format), color_space, format, *k);
+                        });
+                    })->UseRealTime()->Unit(benchmark::kMicrosecond);
+            }
+        }
+    }
+
+    // 多线程: NV12ToRGBParallel (自动选择的内核)，2、4 线程和全部核数
+    std::vector<int> thread_counts = { 2, 4 };
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores > 4) thread_counts.push_back(cores);
+    for (int threads : thread_counts) {
+        NV12ParallelOptions options;
+        options.threads = threads;
+        for (int f = 0; f < kNV12PixelFormatCount; f++) {
+            NV12PixelFormat format = static_cast<NV12PixelFormat>(f);
+            for (const NV12BenchResolution& res : kResolutions) {
+                int w = res.width, h = res.height;
+                benchmark::RegisterBenchmark(BenchName("parallel:" + std::to_string(threads), format, res).c_str(),
+                    [=](benchmark::State& state) {
+                        RunConversion(state, w, h, format, [&](const uint8_t* in, uint8_t* out) {
+                            NV12ToRGBParallel(in, w, in + static_cast<size_t>(w) * h, w, w, h,
+                                              out, w * NV12PixelStride(format), options, color_space, format);
+                        });
+                    })->UseRealTime()->Unit(benchmark::kMicrosecond);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    NV12PerfCounters probe;
+    g_perf_available = probe.Open();
+    if (!g_perf_available) {
+        std::cerr << "perf_event hardware counters unavailable: bytes/cycle uses TSC reference cycles, "
+                     "cache misses are not reported\n";
+    }
+    benchmark::AddCustomContext("default_kernel", g_nv12_kernel.name);
+
+    RegisterBenchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
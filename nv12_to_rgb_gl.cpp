@@ -5,6 +5,8 @@
 #include <string.h>
 #include <X11/Xlib.h>
 
+#include "nv12_color.h"
+
 #define WIDTH 640
 #define HEIGHT 480
 
@@ -20,7 +22,7 @@ const char* vertexShaderSource = R"(
     }
 )";
 
-// 片元着色器：NV12转RGB
+// 片元着色器：NV12转RGB，颜色矩阵和范围由 yuvOffset/yuvMatrix uniform 决定 (见 nv12_color.h)
 const char* fragmentShaderSource = R"(
     #version 300 es
     precision mediump float;
@@ -28,15 +30,12 @@ const char* fragmentShaderSource = R"(
     layout(location = 0) out vec4 outColor;
     uniform sampler2D texY;
     uniform sampler2D texUV;
+)" NV12_GLSL_COLOR_UNIFORMS R"(
     void main() {
         float y = texture(texY, v_texCoord).r;
         vec2 uv = texture(texUV, v_texCoord).rg;
-        float u = uv.x - 0.5;
-        float v = uv.y - 0.5;
-        float r = y + 1.402 * v;
-        float g = y - 0.344136 * u - 0.714136 * v;
-        float b = y + 1.772 * u;
-        outColor = vec4(r, g, b, 1.0);
+        vec3 yuv = vec3(y, uv);
+        outColor = vec4()" NV12_GLSL_COLOR_CONVERT("yuv") R"(, 1.0);
     }
 )";
 
@@ -81,7 +80,14 @@ GLuint createProgram() {
     return prog;
 }
 
-int main() {
+// 用法: ./nv12_to_rgb_gl [bt601|bt709|bt2020] [limited|full]，默认 BT.601 limited
+int main(int argc, char* argv[]) {
+    NV12ColorSpace colorSpace;
+    if (!NV12ParseColorSpace(argc > 1 ? argv[1] : NULL, argc > 2 ? argv[2] : NULL, colorSpace)) {
+        printf("Usage: %s [bt601|bt709|bt2020] [limited|full]\n", argv[0]);
+        return -1;
+    }
+
     // 1. 初始化X11显示
     Display* x_display = XOpenDisplay(NULL);
     if (!x_display) {
@@ -177,6 +183,11 @@ int main() {
     glUniform1i(locY, 0);
     glUniform1i(locUV, 1);
 
+    // 颜色空间参数，与CPU版本 (nv12_to_rgb.cpp) 使用同一套系数
+    NV12ColorUniforms color = NV12ColorShaderUniforms(colorSpace);
+    glUniform3fv(glGetUniformLocation(program, "yuvOffset"), 1, color.offset);
+    glUniformMatrix3fv(glGetUniformLocation(program, "yuvMatrix"), 1, GL_FALSE, color.matrix);
+
     // 8. 创建两个纹理：Y和UV
     GLuint texY, texUV;
     glGenTextures(1, &texY);
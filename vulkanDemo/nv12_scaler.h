@@ -0,0 +1,710 @@
+// ===== nv12_scaler.h =====
+// Long-lived Vulkan NV12 -> NV12 scaler, optionally converting to RGB in the same pass.
+// Instance, device, images, pipelines and descriptor sets are created once in the constructor.
+// Frames go through a ring of framesInFlight slots, each with its own staging buffers, a prerecorded
+// command buffer and a fence. The staging buffers stay mapped for the scaler's lifetime.
+// What the ring overlaps is host and GPU: while the GPU works on frame k the host can fill frame k+1
+// and consume frame k-1. The GPU work itself does not overlap. The images, the Lanczos tmp buffer and
+// rgbOut are shared by all slots (one set instead of depth() sets of device memory), so the barriers
+// at the start of each command buffer wait for the previous frame's dispatch and copies: frames run
+// back to back on the GPU.
+//
+//   Nv12Scaler scaler(config);
+//   scaler.scale(nv12In, nv12Out);   // one frame, blocking. nv12In: inputSize() bytes, nv12Out: outputSize() bytes
+//
+//   // pipelined: keep up to depth() frames queued, results come back in submission order
+//   if (scaler.inFlight() == scaler.depth()) scaler.receive(nv12Out);
+//   scaler.submit(nv12In);
+//
+//   // zero-copy: fill the mapped input directly, consume the mapped output in place
+//   fread(scaler.inputBuffer(), 1, scaler.inputSize(), f);
+//   scaler.submit();
+//   const uint8_t* scaled = scaler.receive();   // valid until the next submit()
+//
+// Errors are fatal (die()), like the rest of the demo.
+
+#ifndef NV12_SCALER_H
+#define NV12_SCALER_H
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../nv12_color.h"
+
+static void die(const char* msg) { std::cerr<<msg<<"\n"; std::exit(1); }
+static std::vector<char> readFile(const char* path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if(!f) die("failed to open file");
+    size_t sz = (size_t)f.tellg();
+    std::vector<char> buf(sz);
+    f.seekg(0);
+    f.read(buf.data(), sz);
+    return buf;
+}
+
+// Scaling filter. Everything but nearest uses per-coordinate weight tables built on the host;
+// Lanczos runs as two separable passes, the others as one 2D pass.
+enum class Nv12ScaleFilter { Nearest, Bilinear, Bicubic, Lanczos };
+
+static bool nv12ScaleFilterFromName(const char* name, Nv12ScaleFilter& filter) {
+    static const char* const names[] = { "nearest", "bilinear", "bicubic", "lanczos" };
+    for (int i=0;i<4;i++) if (strcmp(name, names[i]) == 0) { filter = (Nv12ScaleFilter)i; return true; }
+    return false;
+}
+
+// support radius of the filter kernel, in source pixels at 1:1
+static double nv12FilterRadius(Nv12ScaleFilter f) {
+    switch (f) {
+    case Nv12ScaleFilter::Bilinear: return 1.0;
+    case Nv12ScaleFilter::Bicubic: return 2.0;
+    case Nv12ScaleFilter::Lanczos: return 3.0;
+    default: return 0.5;
+    }
+}
+
+static double nv12FilterKernel(Nv12ScaleFilter f, double x) {
+    x = std::fabs(x);
+    switch (f) {
+    case Nv12ScaleFilter::Bilinear: return x < 1.0 ? 1.0 - x : 0.0;
+    case Nv12ScaleFilter::Bicubic: {  // Keys, a = -0.5
+        const double a = -0.5;
+        if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+        if (x < 2.0) return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+        return 0.0;
+    }
+    case Nv12ScaleFilter::Lanczos: {  // a = 3
+        if (x < 1e-8) return 1.0;
+        if (x >= 3.0) return 0.0;
+        double px = M_PI * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+    default: return x < 0.5 ? 1.0 : 0.0;
+    }
+}
+
+// taps needed for in -> out samples: the kernel is stretched by the downscale ratio so every source
+// pixel contributes (no aliasing), and kept at its 1:1 width when upscaling
+static int nv12FilterTaps(Nv12ScaleFilter f, int in, int out) {
+    double stretch = std::max(1.0, double(in) / out);
+    return 2 * (int)std::ceil(nv12FilterRadius(f) * stretch);
+}
+
+// Normalized weights for one axis: output o reads source start[o] .. start[o]+taps-1 (clamped to the edge).
+// Sample centers are aligned, (o + 0.5) * in / out - 0.5.
+static void nv12FilterAxis(Nv12ScaleFilter f, int in, int out, int taps, int32_t* start, float* weight) {
+    double scale = double(in) / out, stretch = std::max(1.0, scale);
+    for (int o=0;o<out;o++) {
+        double center = (o + 0.5) * scale - 0.5;
+        int first = (int)std::floor(center) - taps / 2 + 1;
+        double sum = 0.0;
+        std::vector<double> w(taps);
+        for (int k=0;k<taps;k++) { w[k] = nv12FilterKernel(f, (first + k - center) / stretch); sum += w[k]; }
+        start[o] = first;
+        for (int k=0;k<taps;k++) weight[size_t(o) * taps + k] = float(w[k] / sum);
+    }
+}
+
+// What the scaler hands back. The RGB formats are converted in the same dispatch that scales,
+// straight from the filtered YUV values, so the scaled NV12 is never written out.
+enum class Nv12ScalerOutput { NV12, RGBA8, BGRA8, RGBPlanarF32 };
+
+static bool nv12ScalerOutputFromName(const char* name, Nv12ScalerOutput& output) {
+    static const char* const names[] = { "nv12", "rgba", "bgra", "rgbf32" };
+    for (int i=0;i<4;i++) if (strcmp(name, names[i]) == 0) { output = (Nv12ScalerOutput)i; return true; }
+    return false;
+}
+
+struct Nv12ScalerConfig {
+    int inW = 640, inH = 480;     // input size, must be even
+    int outW = 320, outH = 240;   // output size, must be even
+    const char* spv = "compute_nv12.spv";  // fused Y+UV scale shader
+    int framesInFlight = 2;       // ring depth, 1..4
+    Nv12ScaleFilter filter = Nv12ScaleFilter::Nearest;
+    Nv12ScalerOutput output = Nv12ScalerOutput::NV12;
+    NV12ColorSpace colorSpace;    // YUV -> RGB matrix and range for the RGB outputs (see ../nv12_color.h)
+    // The shader reads and writes the mapped staging buffers directly, no images, copies or layout
+    // transitions. Faster where those copies dominate (integrated GPUs, lavapipe); on a discrete GPU
+    // every texel is fetched over the bus. Output width must be a multiple of 4.
+    bool bufferIO = false;
+    // Pipeline cache directory; nullptr = $XDG_CACHE_HOME/nv12_scaler or ~/.cache/nv12_scaler, "" = no cache.
+    // Compiled pipelines are loaded from there at startup and saved as soon as they are built (and at
+    // shutdown if the driver added to it), one file per device and driver version, so later runs skip
+    // the shader compile.
+    const char* cacheDir = nullptr;
+};
+
+class Nv12Scaler {
+public:
+    explicit Nv12Scaler(const Nv12ScalerConfig& config) : cfg(config) {
+        if (cfg.inW % 2 != 0 || cfg.inH % 2 != 0 || cfg.outW % 2 != 0 || cfg.outH % 2 != 0) die("width and height must be even for NV12");
+        if (cfg.framesInFlight < 1 || cfg.framesInFlight > 4) die("framesInFlight must be 1..4");
+        if (cfg.bufferIO && cfg.outW % 4 != 0) die("bufferIO needs an output width that is a multiple of 4");
+        createDevice();
+        createResources();
+        createPipelines();
+        for (Slot& slot : slots) recordFrame(slot);
+    }
+
+    ~Nv12Scaler() {
+        vkDeviceWaitIdle(device);
+        vkDestroyPipeline(device, pipeline, nullptr); vkDestroyPipeline(device, pipelineV, nullptr);
+        savePipelineCache();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        vkDestroyPipelineLayout(device, playout, nullptr);
+        vkDestroyDescriptorPool(device, dpool, nullptr);
+        vkDestroyDescriptorSetLayout(device, dsl, nullptr);
+
+        for (Slot& slot : slots) {
+            destroyBuffer(slot.stgIn); destroyBuffer(slot.stgOut);
+            vkDestroyFence(device, slot.fence, nullptr);
+        }
+        destroyImage(imgY); destroyImage(imgUV); destroyImage(outY); destroyImage(outUV); destroyImage(outRGB);
+        destroyBuffer(starts); destroyBuffer(weights); destroyBuffer(tmp); destroyBuffer(rgbOut);
+
+        vkDestroyCommandPool(device, cmdPool, nullptr);
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+
+    Nv12Scaler(const Nv12Scaler&) = delete;
+    Nv12Scaler& operator=(const Nv12Scaler&) = delete;
+
+    size_t inputSize() const { return size_t(cfg.inW) * cfg.inH * 3 / 2; }
+    size_t outputSize() const {
+        size_t pixels = size_t(cfg.outW) * cfg.outH;
+        switch (cfg.output) {
+        case Nv12ScalerOutput::RGBA8: case Nv12ScalerOutput::BGRA8: return pixels * 4;
+        case Nv12ScalerOutput::RGBPlanarF32: return pixels * 3 * sizeof(float);
+        default: return pixels * 3 / 2;
+        }
+    }
+
+    int depth() const { return (int)slots.size(); }
+    int inFlight() const { return pending; }
+
+    // Scale one NV12 frame (Y plane followed by interleaved UV). Blocks until the result is in out.
+    void scale(const uint8_t* in, uint8_t* out) {
+        if (pending != 0) die("scale() with frames in flight, receive() them first");
+        submit(in);
+        receive(out);
+    }
+
+    // Mapped input staging of the slot the next submit() uses: write inputSize() bytes of NV12 here.
+    // Needs a free slot: inFlight() < depth().
+    uint8_t* inputBuffer() {
+        if (pending == depth()) die("inputBuffer() with the ring full, receive() first");
+        return slots[next].stgIn.mapped;
+    }
+
+    // Queue the frame in inputBuffer() without waiting for it.
+    void submit() {
+        if (pending == depth()) die("submit() with the ring full, receive() first");
+        Slot& slot = slots[next];
+        // host writes (coherent memory) are made visible by the submit itself
+        VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO}; si.commandBufferCount = 1; si.pCommandBuffers = &slot.cmd;
+        if (vkQueueSubmit(queue, 1, &si, slot.fence) != VK_SUCCESS) die("queue submit fail");
+        next = (next + 1) % depth();
+        pending++;
+    }
+
+    void submit(const uint8_t* in) {
+        memcpy(inputBuffer(), in, inputSize());
+        submit();
+    }
+
+    // Wait for the oldest queued frame and return its mapped output: outputSize() bytes, valid until the
+    // next submit(). NV12: Y plane then interleaved UV (U,V pairs), exactly the RG8 image layout.
+    // RGBA8/BGRA8: packed 4 bytes per pixel. RGBPlanarF32: R, G and B planes of floats in 0..1.
+    const uint8_t* receive() {
+        if (pending == 0) die("receive() with no frame in flight");
+        Slot& slot = slots[(next + depth() - pending) % depth()];
+        if (vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) die("wait fence fail");
+        vkResetFences(device, 1, &slot.fence);
+        pending--;
+        if (!slot.stgOut.coherent) {
+            VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE}; range.memory = slot.stgOut.memory; range.offset = 0; range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(device, 1, &range);
+        }
+        return slot.stgOut.mapped;
+    }
+
+    void receive(uint8_t* out) { memcpy(out, receive(), outputSize()); }
+
+private:
+    struct Image { VkImage image = VK_NULL_HANDLE; VkDeviceMemory memory = VK_NULL_HANDLE; VkImageView view = VK_NULL_HANDLE; };
+    struct Buffer { VkBuffer buffer = VK_NULL_HANDLE; VkDeviceMemory memory = VK_NULL_HANDLE; uint8_t* mapped = nullptr; bool coherent = true; };
+    // per-frame resources of the ring; the command buffer is recorded once and resubmitted.
+    // Each staging buffer holds a whole frame; for NV12 the UV plane is at offset w*h. The descriptor
+    // set differs between slots only in the staging buffers (bindings 9/10, used by bufferIO).
+    struct Slot { Buffer stgIn, stgOut; VkCommandBuffer cmd = VK_NULL_HANDLE; VkFence fence = VK_NULL_HANDLE; VkDescriptorSet dset = VK_NULL_HANDLE; };
+    // matches PushNV12 in compute_nv12.comp (std430: the mat3 columns are padded to vec4)
+    struct PushConstants { int32_t inW, inH, outW, outH; float yuvOffset[4]; float yuvMatrix[12]; };
+    static_assert(sizeof(PushConstants) == 80 && offsetof(PushConstants, yuvOffset) == 16 && offsetof(PushConstants, yuvMatrix) == 32,
+                  "PushConstants must match the std430 offsets of PushNV12");
+
+    // helper to create Vulkan instance/device/etc. This example keeps things minimal and assumes
+    // a Vulkan-capable driver (Mesa) is available. Not production hardened.
+    void createDevice() {
+        VkApplicationInfo ai{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+        ai.pApplicationName = "nv12_scaler";
+        ai.applicationVersion = VK_MAKE_VERSION(1,0,0);
+        ai.pEngineName = "none";
+        ai.engineVersion = VK_MAKE_VERSION(1,0,0);
+        ai.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo ci{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+        ci.pApplicationInfo = &ai;
+        if (vkCreateInstance(&ci, nullptr, &instance) != VK_SUCCESS) die("vkCreateInstance failed");
+
+        uint32_t gpuCount = 0;
+        vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr);
+        if (gpuCount == 0) die("no GPU with Vulkan support");
+        std::vector<VkPhysicalDevice> gpus(gpuCount);
+        vkEnumeratePhysicalDevices(instance, &gpuCount, gpus.data());
+        physical = gpus[0];
+
+        uint32_t qfCount=0; vkGetPhysicalDeviceQueueFamilyProperties(physical, &qfCount, nullptr);
+        std::vector<VkQueueFamilyProperties> qfs(qfCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical, &qfCount, qfs.data());
+        int qfi = -1;
+        for (int i=0;i<(int)qfCount;i++) if (qfs[i].queueFlags & VK_QUEUE_COMPUTE_BIT) { qfi = i; break; }
+        if (qfi < 0) die("no compute queue");
+
+        float pr = 1.0f;
+        VkDeviceQueueCreateInfo qci{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+        qci.queueFamilyIndex = qfi; qci.queueCount = 1; qci.pQueuePriorities = &pr;
+        VkDeviceCreateInfo dci{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+        dci.queueCreateInfoCount = 1; dci.pQueueCreateInfos = &qci;
+        if (vkCreateDevice(physical, &dci, nullptr, &device) != VK_SUCCESS) die("vkCreateDevice failed");
+        vkGetDeviceQueue(device, qfi, 0, &queue);
+
+        VkCommandPoolCreateInfo pci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pci.queueFamilyIndex = qfi;
+        if (vkCreateCommandPool(device, &pci, nullptr, &cmdPool) != VK_SUCCESS) die("cmdpool create fail");
+
+        slots.resize(cfg.framesInFlight);
+        for (Slot& slot : slots) {
+            VkCommandBufferAllocateInfo cbai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO}; cbai.commandPool = cmdPool; cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; cbai.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &cbai, &slot.cmd) != VK_SUCCESS) die("alloc cb");
+            VkFenceCreateInfo fci{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            if (vkCreateFence(device, &fci, nullptr, &slot.fence) != VK_SUCCESS) die("create fence fail");
+        }
+    }
+
+    // memory type with all of props, one that also has all of preferred if there is one
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props, VkMemoryPropertyFlags preferred = 0) {
+        VkPhysicalDeviceMemoryProperties mp; vkGetPhysicalDeviceMemoryProperties(physical, &mp);
+        for (VkMemoryPropertyFlags want : { props | preferred, props }) {
+            for (uint32_t i=0;i<mp.memoryTypeCount;i++){
+                if ((typeFilter & (1u<<i)) && (mp.memoryTypes[i].propertyFlags & want) == want) return i;
+            }
+        }
+        die("no suitable memory type");
+        return 0;
+    }
+
+    Image createImage(int w, int h, VkFormat fmt, VkImageUsageFlags usage) {
+        Image img;
+        VkImageCreateInfo ici{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        ici.imageType = VK_IMAGE_TYPE_2D;
+        ici.extent = { (uint32_t)w, (uint32_t)h, 1 };
+        ici.mipLevels = 1; ici.arrayLayers = 1; ici.format = fmt; ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; ici.usage = usage; ici.samples = VK_SAMPLE_COUNT_1_BIT;
+        if (vkCreateImage(device, &ici, nullptr, &img.image) != VK_SUCCESS) die("createImage fail");
+        VkMemoryRequirements mr; vkGetImageMemoryRequirements(device, img.image, &mr);
+        VkMemoryAllocateInfo mai{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO}; mai.allocationSize = mr.size;
+        mai.memoryTypeIndex = findMemoryType(mr.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(device, &mai, nullptr, &img.memory) != VK_SUCCESS) die("alloc mem fail");
+        vkBindImageMemory(device, img.image, img.memory, 0);
+
+        VkImageViewCreateInfo ivci{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO}; ivci.image = img.image; ivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        ivci.format = fmt; ivci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; ivci.subresourceRange.levelCount = 1; ivci.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &ivci, nullptr, &img.view) != VK_SUCCESS) die("create view fail");
+        return img;
+    }
+
+    // host-visible buffers are mapped here and stay mapped until destroyBuffer()
+    Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkMemoryPropertyFlags preferred = 0) {
+        Buffer buf;
+        VkBufferCreateInfo bci{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO}; bci.size = size; bci.usage = usage; bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(device, &bci, nullptr, &buf.buffer) != VK_SUCCESS) die("createBuffer fail");
+        VkMemoryRequirements mr; vkGetBufferMemoryRequirements(device, buf.buffer, &mr);
+        VkMemoryAllocateInfo mai{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO}; mai.allocationSize = mr.size;
+        mai.memoryTypeIndex = findMemoryType(mr.memoryTypeBits, props, preferred);
+        if (vkAllocateMemory(device, &mai, nullptr, &buf.memory) != VK_SUCCESS) die("alloc buf mem fail");
+        vkBindBufferMemory(device, buf.buffer, buf.memory, 0);
+        if (props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            VkPhysicalDeviceMemoryProperties mp; vkGetPhysicalDeviceMemoryProperties(physical, &mp);
+            buf.coherent = (mp.memoryTypes[mai.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+            void* p; if (vkMapMemory(device, buf.memory, 0, VK_WHOLE_SIZE, 0, &p) != VK_SUCCESS) die("map buf mem fail");
+            buf.mapped = (uint8_t*)p;
+        }
+        return buf;
+    }
+
+    void destroyImage(Image& img) {
+        vkDestroyImageView(device, img.view, nullptr); vkDestroyImage(device, img.image, nullptr); vkFreeMemory(device, img.memory, nullptr);
+    }
+    void destroyBuffer(Buffer& buf) {
+        if (buf.mapped) vkUnmapMemory(device, buf.memory);
+        vkDestroyBuffer(device, buf.buffer, nullptr); vkFreeMemory(device, buf.memory, nullptr);
+    }
+
+    void createResources() {
+        // input Y/UV (we upload) and output Y/UV (we read back). The shader binds all images and buffers,
+        // so the ones unused by this output format or by bufferIO are minimal placeholders.
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        bool nv12 = cfg.output == Nv12ScalerOutput::NV12 && !cfg.bufferIO;
+        imgY = cfg.bufferIO ? createImage(1, 1, VK_FORMAT_R8_UNORM, usage) : createImage(cfg.inW, cfg.inH, VK_FORMAT_R8_UNORM, usage);
+        imgUV = cfg.bufferIO ? createImage(1, 1, VK_FORMAT_R8G8_UNORM, usage) : createImage(cfg.inW/2, cfg.inH/2, VK_FORMAT_R8G8_UNORM, usage);
+        outY = nv12 ? createImage(cfg.outW, cfg.outH, VK_FORMAT_R8_UNORM, usage) : createImage(1, 1, VK_FORMAT_R8_UNORM, usage);
+        outUV = nv12 ? createImage(cfg.outW/2, cfg.outH/2, VK_FORMAT_R8G8_UNORM, usage) : createImage(1, 1, VK_FORMAT_R8G8_UNORM, usage);
+        bool rgba = (cfg.output == Nv12ScalerOutput::RGBA8 || cfg.output == Nv12ScalerOutput::BGRA8) && !cfg.bufferIO;
+        outRGB = rgba ? createImage(cfg.outW, cfg.outH, VK_FORMAT_R8G8B8A8_UNORM, usage) : createImage(1, 1, VK_FORMAT_R8G8B8A8_UNORM, usage);
+        rgbOut = createBuffer(cfg.output == Nv12ScalerOutput::RGBPlanarF32 && !cfg.bufferIO ? outputSize() : sizeof(float),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        // filter tables: starts and weights of luma x, luma y, chroma x, chroma y, all padded to the
+        // widest axis so the shader has one TAPS. Small and read every frame, so device-local if mappable.
+        taps = 1;
+        if (cfg.filter != Nv12ScaleFilter::Nearest) {
+            taps = std::max(nv12FilterTaps(cfg.filter, cfg.inW, cfg.outW), nv12FilterTaps(cfg.filter, cfg.inH, cfg.outH));
+            taps = std::max(taps, std::max(nv12FilterTaps(cfg.filter, cfg.inW/2, cfg.outW/2), nv12FilterTaps(cfg.filter, cfg.inH/2, cfg.outH/2)));
+        }
+        const int axisIn[4] = { cfg.inW, cfg.inH, cfg.inW/2, cfg.inH/2 }, axisOut[4] = { cfg.outW, cfg.outH, cfg.outW/2, cfg.outH/2 };
+        size_t entries = size_t(cfg.outW) + cfg.outH + cfg.outW/2 + cfg.outH/2;
+        VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        starts = createBuffer(entries * sizeof(int32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        weights = createBuffer(entries * taps * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        size_t e = 0;
+        for (int a=0;a<4 && cfg.filter != Nv12ScaleFilter::Nearest;a++) {
+            nv12FilterAxis(cfg.filter, axisIn[a], axisOut[a], taps, (int32_t*)starts.mapped + e, (float*)weights.mapped + e * taps);
+            e += axisOut[a];
+        }
+        // horizontal pass output of the separable filter: luma outW x inH, then chroma outW/2 x inH/2 pairs
+        size_t tmpFloats = cfg.filter == Nv12ScaleFilter::Lanczos ? size_t(cfg.outW) * cfg.inH * 3 / 2 : 1;
+        tmp = createBuffer(tmpFloats * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        // staging buffers, one input and one output per slot. The host only writes the input
+        // (coherent, write-combined is fine) but reads the output, which is much faster from cached memory.
+        // Sizes are rounded up to whole uints for the bufferIO shader.
+        VkBufferUsageFlags stgUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        for (Slot& slot : slots) {
+            slot.stgIn = createBuffer((inputSize() + 3) & ~size_t(3), stgUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            slot.stgOut = createBuffer((outputSize() + 3) & ~size_t(3), stgUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }
+
+        // all images live in GENERAL between frames; each frame moves them to transfer layouts and back
+        VkCommandBuffer cmd = slots[0].cmd;
+        VkCommandBufferBeginInfo bbi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO}; bbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; vkBeginCommandBuffer(cmd, &bbi);
+        setImageLayout(cmd, {imgY.image, imgUV.image, outY.image, outUV.image, outRGB.image}, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        vkEndCommandBuffer(cmd);
+        VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO}; si.commandBufferCount = 1; si.pCommandBuffers = &cmd;
+        if (vkQueueSubmit(queue, 1, &si, slots[0].fence) != VK_SUCCESS) die("queue submit fail");
+        if (vkWaitForFences(device, 1, &slots[0].fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) die("wait fence fail");
+        vkResetFences(device, 1, &slots[0].fence);
+        vkResetCommandBuffer(cmd, 0);
+    }
+
+    // Pipeline cache file of this device and driver, "" when caching is off or there is no cache directory.
+    // Both keys are in the name so switching GPUs or updating the driver starts a new file instead of
+    // thrashing one.
+    std::string pipelineCachePath(std::string* dir = nullptr) {
+        std::string base;
+        if (cfg.cacheDir) base = cfg.cacheDir;
+        else if (const char* xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg) base = std::string(xdg) + "/nv12_scaler";
+        else if (const char* home = getenv("HOME"); home && *home) base = std::string(home) + "/.cache/nv12_scaler";
+        if (base.empty()) return "";
+        VkPhysicalDeviceProperties props; vkGetPhysicalDeviceProperties(physical, &props);
+        char name[2 * VK_UUID_SIZE + 16];
+        for (int i=0;i<VK_UUID_SIZE;i++) snprintf(name + 2 * i, 3, "%02x", props.pipelineCacheUUID[i]);
+        snprintf(name + 2 * VK_UUID_SIZE, 16, "-%08x", props.driverVersion);
+        if (dir) *dir = base;
+        return base + "/" + name + ".bin";
+    }
+
+    // Create the pipeline cache, seeded from disk if there is a file for this device. The header is
+    // checked here too, since not every driver copes with foreign data.
+    void loadPipelineCache() {
+        std::string path = pipelineCachePath();
+        if (!path.empty()) {
+            std::ifstream f(path, std::ios::binary);
+            cacheData.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        }
+        VkPhysicalDeviceProperties props; vkGetPhysicalDeviceProperties(physical, &props);
+        uint32_t header[4] = {};
+        if (cacheData.size() >= sizeof(header) + VK_UUID_SIZE) memcpy(header, cacheData.data(), sizeof(header));
+        if (header[1] != (uint32_t)VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header[2] != props.vendorID || header[3] != props.deviceID ||
+            memcmp(cacheData.data() + sizeof(header), props.pipelineCacheUUID, VK_UUID_SIZE) != 0) cacheData.clear();
+        VkPipelineCacheCreateInfo pcci{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO}; pcci.initialDataSize = cacheData.size(); pcci.pInitialData = cacheData.data();
+        if (vkCreatePipelineCache(device, &pcci, nullptr, &pipelineCache) != VK_SUCCESS) die("create pipeline cache fail");
+    }
+
+    // Write the cache back if it changed. Called right after the pipelines are created, so a run that
+    // is killed or dies later still leaves the cache behind, and again at shutdown for drivers that
+    // compile lazily at the first dispatch (SwiftShader). Through a temporary file and rename(), so a
+    // concurrent run never reads a half-written cache. Failing to save only costs the next run a compile.
+    void savePipelineCache() {
+        std::string dir, path = pipelineCachePath(&dir);
+        if (path.empty()) return;
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS) return;
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+        data.resize(size);
+        if (data == cacheData) return;
+        // the directory may not exist yet, nor its parents (~/.cache, or any part of a cacheDir path)
+        for (size_t i = dir.find('/', 1); ; i = dir.find('/', i + 1)) {
+            mkdir(dir.substr(0, i).c_str(), 0755);
+            if (i == std::string::npos) break;
+        }
+        std::string tmpPath = path + ".tmp" + std::to_string(getpid());
+        std::ofstream f(tmpPath, std::ios::binary);
+        f.write(data.data(), (std::streamsize)data.size());
+        f.close();
+        if (!f || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::cerr<<"warning: could not save pipeline cache to "<<path<<std::endl;
+            remove(tmpPath.c_str());
+            return;
+        }
+        cacheData.swap(data);
+    }
+
+    // helper to create compute pipeline for a shader
+    void createComputePipeline(const char* spvPath, VkPipelineLayout layout, VkPipeline& pipe, const VkSpecializationInfo* spec = nullptr) {
+        auto spv = readFile(spvPath);
+        VkShaderModule compMod; VkShaderModuleCreateInfo smci{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO}; smci.codeSize = spv.size(); smci.pCode = reinterpret_cast<const uint32_t*>(spv.data()); if (vkCreateShaderModule(device, &smci, nullptr, &compMod) != VK_SUCCESS) die("create shader module fail");
+        VkPipelineShaderStageCreateInfo pss{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO}; pss.stage = VK_SHADER_STAGE_COMPUTE_BIT; pss.module = compMod; pss.pName = "main"; pss.pSpecializationInfo = spec;
+        VkComputePipelineCreateInfo cpci{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO}; cpci.stage = pss; cpci.layout = layout;
+        if (vkCreateComputePipelines(device, pipelineCache, 1, &cpci, nullptr, &pipe) != VK_SUCCESS) die("create comp pipeline fail");
+        vkDestroyShaderModule(device, compMod, nullptr);
+    }
+
+    // storage images of the list go to bindings 0.., then the storage buffers to the bindings after them
+    void writeDescriptorSet(VkDescriptorSet set, std::initializer_list<VkImageView> views, std::initializer_list<VkBuffer> buffers) {
+        VkDescriptorImageInfo dii[12]; VkDescriptorBufferInfo dbi[12]; VkWriteDescriptorSet wds[12]; uint32_t n = 0;
+        for (VkImageView view : views) {
+            dii[n].sampler = VK_NULL_HANDLE; dii[n].imageView = view; dii[n].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            wds[n].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; wds[n].pNext = nullptr; wds[n].dstSet = set; wds[n].dstBinding = n; wds[n].dstArrayElement = 0; wds[n].descriptorCount = 1; wds[n].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; wds[n].pImageInfo = &dii[n]; wds[n].pBufferInfo = nullptr; wds[n].pTexelBufferView = nullptr;
+            n++;
+        }
+        for (VkBuffer buffer : buffers) {
+            dbi[n].buffer = buffer; dbi[n].offset = 0; dbi[n].range = VK_WHOLE_SIZE;
+            wds[n].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; wds[n].pNext = nullptr; wds[n].dstSet = set; wds[n].dstBinding = n; wds[n].dstArrayElement = 0; wds[n].descriptorCount = 1; wds[n].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; wds[n].pImageInfo = nullptr; wds[n].pBufferInfo = &dbi[n]; wds[n].pTexelBufferView = nullptr;
+            n++;
+        }
+        vkUpdateDescriptorSets(device, n, wds, 0, nullptr);
+    }
+
+    void createPipelines() {
+        loadPipelineCache();
+
+        // one layout for both planes: bindings 0/1 = input Y/UV, 2/3 = output Y/UV, 4 = output RGBA images,
+        // 5/6 = filter starts/weights, 7 = separable filter intermediate, 8 = planar float RGB output,
+        // 9/10 = the slot's input/output staging for bufferIO
+        VkDescriptorSetLayoutBinding b[11];
+        for (uint32_t i=0;i<11;i++){ b[i].binding = i; b[i].descriptorType = i < 5 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; b[i].descriptorCount = 1; b[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT; b[i].pImmutableSamplers = nullptr; }
+        VkDescriptorSetLayoutCreateInfo dslci{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO}; dslci.bindingCount = 11; dslci.pBindings = b;
+        if (vkCreateDescriptorSetLayout(device, &dslci, nullptr, &dsl) != VK_SUCCESS) die("create dsl fail");
+
+        VkPushConstantRange pcr{}; pcr.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT; pcr.offset = 0; pcr.size = sizeof(PushConstants);
+        VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO}; plci.setLayoutCount = 1; plci.pSetLayouts = &dsl; plci.pushConstantRangeCount = 1; plci.pPushConstantRanges = &pcr;
+        if (vkCreatePipelineLayout(device, &plci, nullptr, &playout) != VK_SUCCESS) die("create pipeline layout fail");
+
+        uint32_t sets = (uint32_t)slots.size();
+        VkDescriptorPoolSize ps[2]; ps[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; ps[0].descriptorCount = 5 * sets; ps[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; ps[1].descriptorCount = 6 * sets;
+        VkDescriptorPoolCreateInfo dpci{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO}; dpci.maxSets = sets; dpci.poolSizeCount = 2; dpci.pPoolSizes = ps;
+        if (vkCreateDescriptorPool(device, &dpci, nullptr, &dpool) != VK_SUCCESS) die("create dpool fail");
+
+        // allocate and update one descriptor set per slot
+        for (Slot& slot : slots) {
+            VkDescriptorSetAllocateInfo dsai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO}; dsai.descriptorPool = dpool; dsai.descriptorSetCount = 1; dsai.pSetLayouts = &dsl;
+            if (vkAllocateDescriptorSets(device, &dsai, &slot.dset) != VK_SUCCESS) die("alloc dset fail");
+            writeDescriptorSet(slot.dset, {imgY.view, imgUV.view, outY.view, outUV.view, outRGB.view},
+                               {starts.buffer, weights.buffer, tmp.buffer, rgbOut.buffer, slot.stgIn.buffer, slot.stgOut.buffer});
+        }
+
+        // specialization constants select the shader paths: MODE (id 0) and TAPS (id 1) the filter,
+        // OUTPUT (id 2) and SWIZZLE (id 3) what the final pass writes, BUFFER_IO (id 4) images or staging
+        int32_t specData[5] = { 0, taps, 0, cfg.output == Nv12ScalerOutput::BGRA8 ? 1 : 0, cfg.bufferIO ? 1 : 0 };
+        switch (cfg.output) {
+        case Nv12ScalerOutput::RGBA8: case Nv12ScalerOutput::BGRA8: specData[2] = 1; break;
+        case Nv12ScalerOutput::RGBPlanarF32: specData[2] = 2; break;
+        default: specData[2] = 0; break;
+        }
+        VkSpecializationMapEntry specEntries[5];
+        for (uint32_t i=0;i<5;i++) specEntries[i] = { i, uint32_t(i * sizeof(int32_t)), sizeof(int32_t) };
+        VkSpecializationInfo spec{5, specEntries, sizeof(specData), specData};
+        switch (cfg.filter) {
+        case Nv12ScaleFilter::Nearest: specData[0] = 0; break;
+        case Nv12ScaleFilter::Lanczos: specData[0] = 2; break;
+        default: specData[0] = 1; break;
+        }
+        createComputePipeline(cfg.spv, playout, pipeline, &spec);
+        if (cfg.filter == Nv12ScaleFilter::Lanczos) {
+            specData[0] = 3;
+            createComputePipeline(cfg.spv, playout, pipelineV, &spec);
+        }
+        savePipelineCache();
+    }
+
+    // Record one frame for a slot: upload, the scale dispatch and readback in one command buffer.
+    // The work only depends on the slot's buffers, so it is recorded once and resubmitted every frame.
+    void recordFrame(Slot& slot) {
+        VkCommandBuffer cmd = slot.cmd;
+        VkCommandBufferBeginInfo bbi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO}; vkBeginCommandBuffer(cmd, &bbi);
+
+        if (!cfg.bufferIO) {
+            // copy staging -> images. The first barrier also waits for the previous frame's dispatches
+            // (from any slot) to finish reading the input images.
+            setImageLayout(cmd, {imgY.image, imgUV.image}, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            // w*h is a multiple of 4 (even sizes), a valid buffer offset for the UV copy
+            copyBufferToImage(cmd, slot.stgIn.buffer, 0, imgY.image, cfg.inW, cfg.inH);
+            copyBufferToImage(cmd, slot.stgIn.buffer, size_t(cfg.inW) * cfg.inH, imgUV.image, cfg.inW/2, cfg.inH/2);
+            setImageLayout(cmd, {imgY.image, imgUV.image}, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+        } else if (pipelineV != VK_NULL_HANDLE) {
+            // the slot's buffers are its own, only tmp is shared: the previous frame's vertical pass must be
+            // done with it before this frame's horizontal pass overwrites it
+            computeBarrier(cmd, tmp.buffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        }
+
+        // one invocation per output chroma sample, each also writes its 2x2 luma block
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, playout, 0, 1, &slot.dset, 0, nullptr);
+        PushConstants push{cfg.inW, cfg.inH, cfg.outW, cfg.outH};
+        NV12ColorUniforms color = NV12ColorShaderUniforms(cfg.colorSpace);
+        for (int i=0;i<3;i++) push.yuvOffset[i] = color.offset[i];
+        for (int col=0;col<3;col++) for (int row=0;row<3;row++) push.yuvMatrix[col * 4 + row] = color.matrix[col * 3 + row];
+        vkCmdPushConstants(cmd, playout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        // the bufferIO final pass takes two chroma columns per invocation
+        uint32_t groupsX = cfg.bufferIO ? (cfg.outW/4 + 15) / 16 : (cfg.outW/2 + 15) / 16;
+        if (pipelineV == VK_NULL_HANDLE) {
+            vkCmdDispatch(cmd, groupsX, (cfg.outH/2 + 15) / 16, 1);
+        } else {
+            // separable: horizontal pass over the input rows into tmp, then the vertical pass reads it.
+            // The previous frame's vertical pass is done reading tmp: the input upload barriers above
+            // chain compute -> transfer -> compute (with bufferIO, the tmp barrier at the start).
+            vkCmdDispatch(cmd, (cfg.outW/2 + 15) / 16, (cfg.inH/2 + 15) / 16, 1);
+            computeBarrier(cmd, tmp.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineV);
+            vkCmdDispatch(cmd, groupsX, (cfg.outH/2 + 15) / 16, 1);
+        }
+
+        if (cfg.bufferIO) {
+            // the shader wrote the staging directly, make that visible to the host reads in receive()
+            VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER}; mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT; mb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &mb, 0, nullptr, 0, nullptr);
+            if (vkEndCommandBuffer(cmd) != VK_SUCCESS) die("record frame fail");
+            return;
+        }
+
+        // output -> staging. Images go back to GENERAL so the next frame's dispatch can write them; the next
+        // frame's upload barrier (transfer -> compute) also orders its dispatch after this frame's copies.
+        switch (cfg.output) {
+        case Nv12ScalerOutput::NV12:
+            setImageLayout(cmd, {outY.image, outUV.image}, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+            copyImageToBuffer(cmd, outY.image, slot.stgOut.buffer, 0, cfg.outW, cfg.outH);
+            copyImageToBuffer(cmd, outUV.image, slot.stgOut.buffer, size_t(cfg.outW) * cfg.outH, cfg.outW/2, cfg.outH/2);
+            setImageLayout(cmd, {outY.image, outUV.image}, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+            break;
+        case Nv12ScalerOutput::RGBA8: case Nv12ScalerOutput::BGRA8:
+            setImageLayout(cmd, {outRGB.image}, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+            copyImageToBuffer(cmd, outRGB.image, slot.stgOut.buffer, 0, cfg.outW, cfg.outH);
+            setImageLayout(cmd, {outRGB.image}, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+            break;
+        case Nv12ScalerOutput::RGBPlanarF32: {
+            VkBufferMemoryBarrier bmb{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER}; bmb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT; bmb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            bmb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; bmb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; bmb.buffer = rgbOut.buffer; bmb.offset = 0; bmb.size = VK_WHOLE_SIZE;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &bmb, 0, nullptr);
+            VkBufferCopy bc{0, 0, outputSize()};
+            vkCmdCopyBuffer(cmd, rgbOut.buffer, slot.stgOut.buffer, 1, &bc);
+            break;
+        }
+        }
+
+        // make the copies visible to the host reads in receive()
+        VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER}; mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; mb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &mb, 0, nullptr, 0, nullptr);
+        if (vkEndCommandBuffer(cmd) != VK_SUCCESS) die("record frame fail");
+    }
+
+    // compute -> compute dependency on one buffer
+    static void computeBarrier(VkCommandBuffer cmd, VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkBufferMemoryBarrier bmb{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER}; bmb.srcAccessMask = srcAccess; bmb.dstAccessMask = dstAccess;
+        bmb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; bmb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; bmb.buffer = buffer; bmb.offset = 0; bmb.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bmb, 0, nullptr);
+    }
+
+    // access mask and pipeline stage that use an image in the given layout
+    static void layoutUsage(VkImageLayout layout, VkAccessFlags& access, VkPipelineStageFlags& stage) {
+        switch (layout) {
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: access = VK_ACCESS_TRANSFER_WRITE_BIT; stage = VK_PIPELINE_STAGE_TRANSFER_BIT; break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: access = VK_ACCESS_TRANSFER_READ_BIT; stage = VK_PIPELINE_STAGE_TRANSFER_BIT; break;
+        case VK_IMAGE_LAYOUT_GENERAL: access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT; stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT; break;
+        default: access = 0; stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT; break;
+        }
+    }
+
+    // one vkCmdPipelineBarrier moving every image in the list between the same two layouts
+    void setImageLayout(VkCommandBuffer cmd, std::initializer_list<VkImage> images, VkImageLayout oldLayout, VkImageLayout newLayout) {
+        VkImageMemoryBarrier barriers[5]; uint32_t n = 0;
+        VkPipelineStageFlags srcStage, dstStage;
+        for (VkImage image : images) {
+            VkImageMemoryBarrier& barrier = barriers[n++];
+            barrier = VkImageMemoryBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER}; barrier.oldLayout = oldLayout; barrier.newLayout = newLayout; barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; barrier.image = image; barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            layoutUsage(oldLayout, barrier.srcAccessMask, srcStage);
+            layoutUsage(newLayout, barrier.dstAccessMask, dstStage);
+        }
+        vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, n, barriers);
+    }
+
+    void copyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkImage image, int w, int h) {
+        VkBufferImageCopy bic{}; bic.bufferOffset = offset; bic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; bic.imageSubresource.layerCount = 1; bic.imageExtent = {(uint32_t)w,(uint32_t)h,1};
+        vkCmdCopyBufferToImage(cmd, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bic);
+    }
+
+    void copyImageToBuffer(VkCommandBuffer cmd, VkImage image, VkBuffer buffer, VkDeviceSize offset, int w, int h) {
+        VkBufferImageCopy bic{}; bic.bufferOffset = offset; bic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; bic.imageSubresource.layerCount = 1; bic.imageExtent = {(uint32_t)w,(uint32_t)h,1};
+        vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &bic);
+    }
+
+    Nv12ScalerConfig cfg;
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physical = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool cmdPool = VK_NULL_HANDLE;
+
+    Image imgY, imgUV, outY, outUV;
+    Image outRGB;                   // RGBA8/BGRA8 output
+    Buffer rgbOut;                  // planar float RGB output
+    Buffer starts, weights, tmp;    // filter tables and separable intermediate
+    int taps = 1;
+    std::vector<Slot> slots;
+    int next = 0;       // slot the next submit() uses
+    int pending = 0;    // submitted but not yet received, oldest at next - pending
+
+    VkDescriptorSetLayout dsl = VK_NULL_HANDLE;
+    VkPipelineLayout playout = VK_NULL_HANDLE;
+    VkDescriptorPool dpool = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipeline pipelineV = VK_NULL_HANDLE;   // Lanczos vertical pass
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::vector<char> cacheData;             // as last loaded or saved, to skip writing an unchanged cache
+};
+
+#endif // NV12_SCALER_H